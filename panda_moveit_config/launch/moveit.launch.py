@@ -18,8 +18,10 @@ def generate_launch_description():
         .robot_description_semantic(file_path="config/panda.srdf")
         #.trajectory_execution(file_path="config/gripper_moveit_controllers.yaml")
         .planning_pipelines(
-            #pipelines=["ompl", "chomp", "pilz_industrial_motion_planner"]
-            pipelines=["pilz_industrial_motion_planner"]
+            # pilz stays the default, OMPL and CHOMP are raced against it
+            # by the speculative planning mode of benchmark_asynchronous
+            default_planning_pipeline="pilz_industrial_motion_planner",
+            pipelines=["pilz_industrial_motion_planner", "ompl", "chomp"]
         )
         .to_moveit_configs()
     )
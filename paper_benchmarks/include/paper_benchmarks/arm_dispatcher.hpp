@@ -0,0 +1,198 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Wakes the dispatch loop as soon as something it waits for happens (an arm
+// finishes, new cubes arrive) instead of polling on a fixed period. Busy
+// state is atomic so it can be read from any thread without the lock, and
+// the time every arm spends idle is accumulated as a metric.
+class ArmDispatcher
+{
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct Arm
+    {
+        std::atomic<bool> busy;
+        clock::time_point idle_since;
+        clock::duration idle_total;
+        size_t dispatched;
+    };
+
+    std::unique_ptr<Arm[]> arms;
+    size_t arm_count;
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    unsigned long long epoch = 0;
+    // the arm after the last one handed out is looked at first, so a lower
+    // arm that keeps coming back idle cannot starve the others
+    size_t next_arm = 0;
+
+    void signal()
+    {
+        epoch++;
+        changed.notify_all();
+    }
+
+    int firstIdleArm() const
+    {
+        for (size_t k = 0; k < arm_count; ++k)
+        {
+            size_t i = (next_arm + k) % arm_count;
+            if (!arms[i].busy.load())
+            {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+public:
+    explicit ArmDispatcher(size_t count) : arms(new Arm[count]), arm_count(count)
+    {
+        clock::time_point now = clock::now();
+        for (size_t i = 0; i < arm_count; ++i)
+        {
+            arms[i].busy.store(false);
+            arms[i].idle_since = now;
+            arms[i].idle_total = clock::duration::zero();
+            arms[i].dispatched = 0;
+        }
+    }
+
+    size_t size() const
+    {
+        return arm_count;
+    }
+
+    bool busy(size_t arm) const
+    {
+        return arms[arm].busy.load();
+    }
+
+    // Starts the idle clocks over, e.g. once the robots are homed.
+    void resetMetrics()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        clock::time_point now = clock::now();
+        for (size_t i = 0; i < arm_count; ++i)
+        {
+            arms[i].idle_since = now;
+            arms[i].idle_total = clock::duration::zero();
+            arms[i].dispatched = 0;
+        }
+    }
+
+    void markBusy(size_t arm)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!arms[arm].busy.exchange(true))
+        {
+            arms[arm].idle_total += clock::now() - arms[arm].idle_since;
+            arms[arm].dispatched++;
+        }
+    }
+
+    void markIdle(size_t arm)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (arms[arm].busy.exchange(false))
+        {
+            arms[arm].idle_since = clock::now();
+        }
+        signal();
+    }
+
+    // Wakes the dispatcher, e.g. after new cubes were queued.
+    void notify()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        signal();
+    }
+
+    // Blocks until an arm is idle and has_work() holds, or the timeout
+    // expires. Returns the idle arm or -1 on timeout; idle arms take turns.
+    // has_work() is called with the dispatcher lock held and must not call
+    // back into it.
+    template <typename Predicate>
+    int waitForIdleArm(Predicate has_work, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        int arm = -1;
+        changed.wait_for(lock, timeout, [&]()
+                         { arm = firstIdleArm(); return arm >= 0 && has_work(); });
+        if (arm < 0 || !has_work())
+        {
+            return -1;
+        }
+        next_arm = (arm + 1) % arm_count;
+        return arm;
+    }
+
+    // Blocks until the next markIdle()/notify() or the timeout, for when the
+    // dispatcher cannot make progress with the current state.
+    void waitForEvent(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        unsigned long long seen = epoch;
+        changed.wait_for(lock, timeout, [&]()
+                         { return epoch != seen; });
+    }
+
+    void waitAllIdle()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]()
+                     {
+            for (size_t i = 0; i < arm_count; ++i)
+            {
+                if (arms[i].busy.load())
+                    return false;
+            }
+            return true; });
+    }
+
+    // total idle time of an arm so far, including the current idle period
+    double idleSeconds(size_t arm) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        clock::duration total = arms[arm].idle_total;
+        if (!arms[arm].busy.load())
+        {
+            total += clock::now() - arms[arm].idle_since;
+        }
+        return std::chrono::duration<double>(total).count();
+    }
+
+    size_t dispatched(size_t arm) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return arms[arm].dispatched;
+    }
+};
+
+// Marks an arm idle when the task holding it ends, also when the task
+// throws, so waitAllIdle() and the dispatch loop never wait on an arm
+// whose task is gone.
+class ArmIdleGuard
+{
+private:
+    ArmDispatcher &dispatcher;
+    size_t arm;
+
+public:
+    ArmIdleGuard(ArmDispatcher &d, size_t a) : dispatcher(d), arm(a) {}
+
+    ArmIdleGuard(const ArmIdleGuard &) = delete;
+    ArmIdleGuard &operator=(const ArmIdleGuard &) = delete;
+
+    ~ArmIdleGuard()
+    {
+        dispatcher.markIdle(arm);
+    }
+};
\ No newline at end of file
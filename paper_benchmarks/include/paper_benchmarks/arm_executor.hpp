@@ -0,0 +1,98 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// A single long-lived worker thread with a FIFO task queue, one per arm.
+// Tasks are taken by value and run one after the other, so an arm never
+// executes two motions at once, and submit() hands back a future with the
+// task's result. Exceptions thrown by a task end up in its future.
+class ArmExecutor
+{
+private:
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<std::function<void()>> tasks;
+    bool stopping = false;
+    size_t completed_count = 0;
+    // declared last so everything above exists when the thread starts
+    std::thread worker;
+
+    void run()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                available.wait(lock, [this]()
+                               { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+
+            task();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            completed_count++;
+        }
+    }
+
+public:
+    ArmExecutor() : worker([this]()
+                           { run(); })
+    {
+    }
+
+    ArmExecutor(const ArmExecutor &) = delete;
+    ArmExecutor &operator=(const ArmExecutor &) = delete;
+
+    // finishes the queued tasks, then joins the worker
+    ~ArmExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        worker.join();
+    }
+
+    template <typename Task>
+    auto submit(Task task) -> std::future<decltype(task())>
+    {
+        typedef decltype(task()) Result;
+        // std::function needs a copyable callable, packaged_task is move only
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace_back([packaged]()
+                               { (*packaged)(); });
+        }
+        available.notify_one();
+        return result;
+    }
+
+    // tasks queued but not started yet
+    size_t pending()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return tasks.size();
+    }
+
+    size_t completed()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return completed_count;
+    }
+};
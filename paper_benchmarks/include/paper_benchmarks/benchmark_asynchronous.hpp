@@ -3,11 +3,17 @@
 
 #include <rclcpp/rclcpp.hpp>
 #include <moveit/move_group_interface/move_group_interface.h>
+#include <moveit/planning_scene_monitor/planning_scene_monitor.h>
 #include "paper_benchmarks/scene.hpp"
 #include "paper_benchmarks/primitive_pick_and_place.hpp"
 #include <chrono>
 #include "std_msgs/msg/string.hpp"
-#include "paper_benchmarks/cube_selector.hpp"
+#include "paper_benchmarks/sharded_cube_queue.hpp"
+#include "paper_benchmarks/task_assignment.hpp"
+#include "paper_benchmarks/arm_dispatcher.hpp"
+#include "paper_benchmarks/arm_executor.hpp"
+#include "paper_benchmarks/stage_pipeline.hpp"
+#include "paper_benchmarks/workspace_overlap.hpp"
 
 using namespace std::chrono_literals;
 
@@ -20,8 +26,48 @@ tray_helper red_tray_1(4,4,-0.425,-0.925,0.06,0.1,true);
 tray_helper blue_tray_2(4,4,0.11,0.925,0.06,0.1,false);
 tray_helper red_tray_2(4,4,-0.425,0.925,0.06,0.1,false);
 
-bool panda_1_busy = false;
-bool panda_2_busy = false;
+// cube selection: "euclideanDistance", "randomDistance" or "assignment"
+std::string distanceType = "euclideanDistance";
+// cost used by the assignment mode: "cartesian", "jointSpace", "motionTime"
+// or "sampledJointSpace"
+std::string assignmentCost = "cartesian";
+// plan the next pick and place stage while the current one executes
+bool planAhead = true;
+// replay trajectories of the tray stages instead of planning them again
+bool cacheTrajectories = true;
+// join the stages between two gripper events into one motion
+bool blendSegments = false;
+// time every motion again with a scaling per stage instead of the move
+// group's blanket one
+bool retimeTrajectories = false;
+// shortcut and smooth every planned path before it is executed
+bool shortcutPaths = false;
+// race every joint goal across pilz, OMPL and CHOMP
+bool speculativePlanning = false;
+// planning time and attempts per stage and arm from the solve times so far
+bool adaptiveBudget = false;
+// delay a motion that would run into the other arm's motion
+bool reserveMotions = false;
+// "independent" dispatches every arm on its own, "hybrid" moves pairs of
+// tasks whose workspaces overlap together in dual_arm
+std::string schedulingMode = "independent";
+
+// busy state and idle time of panda_1 (arm 0) and panda_2 (arm 1)
+ArmDispatcher dispatcher(2);
+
+// a pick and place handed to an arm's executor, and what came of it
+struct ArmTask
+{
+  CollisionPlanningObject cube;
+  tray_helper *tray;
+  WorkspaceBox workspace;
+};
+
+struct ArmTaskOutcome
+{
+  CollisionPlanningObject cube;
+  bool success;
+};
 
 const rclcpp::Logger LOGGER = rclcpp::get_logger("benchmark_asynchronous");
 void main_thread();
@@ -30,8 +76,8 @@ bool executeTrajectory(std::shared_ptr<primitive_pick_and_place> pnp,moveit_msgs
 
 rclcpp::Publisher<std_msgs::msg::String>::SharedPtr publisher_;
 std::vector<std::string> all_objects;
-Point3D e(0,0,0);
-ThreadSafeCubeQueue objs(e);
+// one shard per arm, anchored at the arm bases of dual_panda.urdf.xacro
+ShardedCubeQueue objs({Point3D(0, -0.5, 1), Point3D(0, 0.5, 1)});
 
 std::map<std::string, moveit_msgs::msg::CollisionObject> objMap;
 std::map<std::string, moveit_msgs::msg::ObjectColor> colors;
@@ -3,10 +3,15 @@
 
 #include <rclcpp/rclcpp.hpp>
 #include <moveit/move_group_interface/move_group_interface.h>
+#include <moveit/planning_scene_monitor/planning_scene_monitor.h>
 #include "paper_benchmarks/scene.hpp"
 #include "paper_benchmarks/primitive_pick_and_place.hpp"
 #include "std_msgs/msg/string.hpp"
 #include "paper_benchmarks/cube_selector.hpp"
+#include "paper_benchmarks/task_assignment.hpp"
+#include "paper_benchmarks/trajectory_blender.hpp"
+#include "paper_benchmarks/decoupled_planner.hpp"
+#include "paper_benchmarks/motion_pipeline.hpp"
 
 rclcpp::Node::SharedPtr node;
 
@@ -21,6 +26,19 @@ tray_helper red_tray_1(4, 4, -0.425, -0.925, 0.06, 0.1, true);
 tray_helper blue_tray_2(4, 4, 0.11, 0.925, 0.06, 0.1, false);
 tray_helper red_tray_2(4, 4, -0.425, 0.925, 0.06, 0.1, false);
 
+// cube selection: "euclideanDistance", "randomDistance" or "assignment"
+std::string distanceType = "euclideanDistance";
+// plan the stages between two gripper events first and execute them as one
+// joined motion
+bool blendSegments = false;
+// "joint" plans both arms at once in dual_arm, "decoupled" plans panda_1
+// and then panda_2 around it
+std::string planningMode = "joint";
+// set in the decoupled mode
+DecoupledPlanner *decoupled_planner = nullptr;
+// plan the next movement while the current one executes
+bool pipelineExecution = false;
+
 const rclcpp::Logger LOGGER = rclcpp::get_logger("benchmark_synchronous");
 void main_thread();
 void update_planning_scene();
@@ -63,8 +81,16 @@ std::map<std::string, moveit_msgs::msg::CollisionObject> objMap;
 std::map<std::string, moveit_msgs::msg::ObjectColor> colors;
 bool update_scene_called_once = false;
 
+// With `deferred` the movement is only planned, from the end of the last
+// plan in it, and appended there for execute_deferred(). With `pipeline`
+// it is planned from where the motion in flight ends and started once that
+// one is done, without waiting for it to finish.
 bool plan_and_move(dual_arm_state &arm_system, Movement movement, moveit::core::RobotStatePtr kinematic_state,
                    double timeout, moveit::planning_interface::MoveGroupInterface &dual_arm, tray_helper *active_tray_arm_1,
-                   tray_helper *active_tray_arm_2);
+                   tray_helper *active_tray_arm_2,
+                   std::vector<moveit::planning_interface::MoveGroupInterface::Plan> *deferred = nullptr,
+                   MotionPipeline *pipeline = nullptr);
+bool execute_deferred(moveit::planning_interface::MoveGroupInterface &dual_arm, TrajectoryBlender &blender,
+                      std::vector<moveit::planning_interface::MoveGroupInterface::Plan> &deferred);
 
 #endif
\ No newline at end of file
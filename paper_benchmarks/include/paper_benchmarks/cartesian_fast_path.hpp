@@ -0,0 +1,66 @@
+#pragma once
+
+#include <moveit/move_group_interface/move_group_interface.h>
+#include <geometry_msgs/msg/pose.hpp>
+#include <moveit_msgs/msg/robot_trajectory.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+// Straight-line motions for the vertical stages of a pick and place. The
+// grasp, premove, putdown and postmove stages only move the gripper 0.15 m
+// up or down from where the previous stage ended, which does not need a
+// sampling planner: the line is interpolated with computeCartesianPath, which
+// solves IK every eef_step and checks each waypoint against the planning
+// scene, and is time parameterized by the move group. A line that is blocked
+// or jumps between IK branches is rejected, and the caller falls back to
+// a regular plan.
+
+// largest joint change between two waypoints before the line counts as an
+// IK branch flip
+const double straight_line_max_joint_step = 0.2;
+
+// true if `to` is reached from `from` by moving along the vertical only
+inline bool vertical_move(const geometry_msgs::msg::Pose &from, const geometry_msgs::msg::Pose &to, double tolerance = 1e-4)
+{
+    if (std::fabs(from.position.x - to.position.x) > tolerance || std::fabs(from.position.y - to.position.y) > tolerance ||
+        std::fabs(from.position.z - to.position.z) <= tolerance)
+    {
+        return false;
+    }
+    // q and -q are the same orientation
+    double dot = from.orientation.x * to.orientation.x + from.orientation.y * to.orientation.y +
+                 from.orientation.z * to.orientation.z + from.orientation.w * to.orientation.w;
+    return std::fabs(std::fabs(dot) - 1) <= tolerance;
+}
+
+// Plans a straight line from the group's start state to `target`. On
+// success `plan` holds the trajectory and the time the interpolation took.
+inline bool plan_straight_line(moveit::planning_interface::MoveGroupInterface &group, const geometry_msgs::msg::Pose &target,
+                               moveit::planning_interface::MoveGroupInterface::Plan &plan, double eef_step = 0.01)
+{
+    auto start = std::chrono::steady_clock::now();
+    moveit_msgs::msg::RobotTrajectory trajectory;
+    double fraction = group.computeCartesianPath(std::vector<geometry_msgs::msg::Pose>{target}, eef_step, 0.0, trajectory, true);
+    if (fraction < 1.0 || trajectory.joint_trajectory.points.size() < 2)
+    {
+        return false;
+    }
+
+    const auto &points = trajectory.joint_trajectory.points;
+    for (size_t i = 1; i < points.size(); ++i)
+    {
+        for (size_t j = 0; j < points[i].positions.size(); ++j)
+        {
+            if (std::fabs(points[i].positions[j] - points[i - 1].positions[j]) > straight_line_max_joint_step)
+            {
+                return false;
+            }
+        }
+    }
+
+    plan.trajectory_ = trajectory;
+    plan.planning_time_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Packed structure-of-arrays mirror of the cube positions. Entry i belongs to
+// the same storage slot as the i-th message in the owning container, so the
+// distance scans never have to touch the (large) CollisionObject messages.
+struct CubePositionsSoA
+{
+    enum Flags : uint32_t
+    {
+        LIVE = 1u << 0,
+        ROBOT_1_EXHAUSTED = 1u << 1,
+        ROBOT_2_EXHAUSTED = 1u << 2,
+        RESERVED = 1u << 3,
+        ROBOT_1_UNREACHABLE = 1u << 4,
+        ROBOT_2_UNREACHABLE = 1u << 5
+    };
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<uint32_t> flags;
+
+    size_t size() const
+    {
+        return x.size();
+    }
+
+    void resize(size_t n)
+    {
+        x.resize(n, 0.f);
+        y.resize(n, 0.f);
+        z.resize(n, 0.f);
+        flags.resize(n, 0u);
+    }
+
+    void set(size_t i, float px, float py, float pz, uint32_t f)
+    {
+        if (i >= size())
+        {
+            resize(i + 1);
+        }
+        x[i] = px;
+        y[i] = py;
+        z[i] = pz;
+        flags[i] = f;
+    }
+
+    void clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+        flags.clear();
+    }
+};
+
+namespace cube_distance
+{
+
+// An entry takes part in the search when (flags & require) == require and
+// (flags & reject) == 0. Ties resolve to the lowest index. Returns n if no
+// entry qualifies; otherwise best_squared holds the winning squared distance.
+inline size_t argminScalar(const float *x, const float *y, const float *z, const uint32_t *flags, size_t n,
+                           float px, float py, float pz, uint32_t require, uint32_t reject, float &best_squared)
+{
+    size_t best = n;
+    best_squared = std::numeric_limits<float>::infinity();
+    for (size_t i = 0; i < n; ++i)
+    {
+        if ((flags[i] & require) != require || (flags[i] & reject) != 0)
+        {
+            continue;
+        }
+        float dx = x[i] - px;
+        float dy = y[i] - py;
+        float dz = z[i] - pz;
+        float d = dx * dx + dy * dy + dz * dz;
+        if (d < best_squared)
+        {
+            best_squared = d;
+            best = i;
+        }
+    }
+    return best;
+}
+
+#if defined(__AVX2__)
+
+inline size_t argminSimd(const float *x, const float *y, const float *z, const uint32_t *flags, size_t n,
+                         float px, float py, float pz, uint32_t require, uint32_t reject, float &best_squared)
+{
+    const __m256 qx = _mm256_set1_ps(px);
+    const __m256 qy = _mm256_set1_ps(py);
+    const __m256 qz = _mm256_set1_ps(pz);
+    const __m256 inf = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+    const __m256i req = _mm256_set1_epi32(static_cast<int>(require));
+    const __m256i rej = _mm256_set1_epi32(static_cast<int>(reject));
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i step = _mm256_set1_epi32(8);
+
+    __m256 best_d = inf;
+    __m256i best_i = _mm256_set1_epi32(-1);
+    __m256i lane_i = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), qx);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), qy);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + i), qz);
+        __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+
+        __m256i f = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(flags + i));
+        __m256i ok = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_and_si256(f, req), req),
+                                      _mm256_cmpeq_epi32(_mm256_and_si256(f, rej), zero));
+        d = _mm256_blendv_ps(inf, d, _mm256_castsi256_ps(ok));
+
+        // strict less keeps the earlier index of each lane on ties
+        __m256 better = _mm256_cmp_ps(d, best_d, _CMP_LT_OQ);
+        best_d = _mm256_blendv_ps(best_d, d, better);
+        best_i = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(best_i), _mm256_castsi256_ps(lane_i), better));
+        lane_i = _mm256_add_epi32(lane_i, step);
+    }
+
+    alignas(32) float lane_d[8];
+    alignas(32) int32_t lane_idx[8];
+    _mm256_store_ps(lane_d, best_d);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(lane_idx), best_i);
+
+    size_t best = n;
+    best_squared = std::numeric_limits<float>::infinity();
+    for (int l = 0; l < 8; ++l)
+    {
+        if (lane_idx[l] < 0)
+            continue;
+        size_t idx = static_cast<size_t>(lane_idx[l]);
+        if (lane_d[l] < best_squared || (lane_d[l] == best_squared && idx < best))
+        {
+            best_squared = lane_d[l];
+            best = idx;
+        }
+    }
+
+    float tail_squared;
+    size_t tail = argminScalar(x + i, y + i, z + i, flags + i, n - i, px, py, pz, require, reject, tail_squared);
+    if (tail < n - i && tail_squared < best_squared)
+    {
+        best_squared = tail_squared;
+        best = i + tail;
+    }
+    return best;
+}
+
+#elif defined(__SSE2__)
+
+inline size_t argminSimd(const float *x, const float *y, const float *z, const uint32_t *flags, size_t n,
+                         float px, float py, float pz, uint32_t require, uint32_t reject, float &best_squared)
+{
+    const __m128 qx = _mm_set1_ps(px);
+    const __m128 qy = _mm_set1_ps(py);
+    const __m128 qz = _mm_set1_ps(pz);
+    const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+    const __m128i req = _mm_set1_epi32(static_cast<int>(require));
+    const __m128i rej = _mm_set1_epi32(static_cast<int>(reject));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i step = _mm_set1_epi32(4);
+
+    __m128 best_d = inf;
+    __m128i best_i = _mm_set1_epi32(-1);
+    __m128i lane_i = _mm_setr_epi32(0, 1, 2, 3);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), qx);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), qy);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), qz);
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i *>(flags + i));
+        __m128 ok = _mm_castsi128_ps(_mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(f, req), req),
+                                                   _mm_cmpeq_epi32(_mm_and_si128(f, rej), zero)));
+        d = _mm_or_ps(_mm_and_ps(ok, d), _mm_andnot_ps(ok, inf));
+
+        // SSE2 has no blendv, select with and/andnot/or
+        __m128 better = _mm_cmplt_ps(d, best_d);
+        best_d = _mm_or_ps(_mm_and_ps(better, d), _mm_andnot_ps(better, best_d));
+        __m128i better_i = _mm_castps_si128(better);
+        best_i = _mm_or_si128(_mm_and_si128(better_i, lane_i), _mm_andnot_si128(better_i, best_i));
+        lane_i = _mm_add_epi32(lane_i, step);
+    }
+
+    alignas(16) float lane_d[4];
+    alignas(16) int32_t lane_idx[4];
+    _mm_store_ps(lane_d, best_d);
+    _mm_store_si128(reinterpret_cast<__m128i *>(lane_idx), best_i);
+
+    size_t best = n;
+    best_squared = std::numeric_limits<float>::infinity();
+    for (int l = 0; l < 4; ++l)
+    {
+        if (lane_idx[l] < 0)
+            continue;
+        size_t idx = static_cast<size_t>(lane_idx[l]);
+        if (lane_d[l] < best_squared || (lane_d[l] == best_squared && idx < best))
+        {
+            best_squared = lane_d[l];
+            best = idx;
+        }
+    }
+
+    float tail_squared;
+    size_t tail = argminScalar(x + i, y + i, z + i, flags + i, n - i, px, py, pz, require, reject, tail_squared);
+    if (tail < n - i && tail_squared < best_squared)
+    {
+        best_squared = tail_squared;
+        best = i + tail;
+    }
+    return best;
+}
+
+#else
+
+inline size_t argminSimd(const float *x, const float *y, const float *z, const uint32_t *flags, size_t n,
+                         float px, float py, float pz, uint32_t require, uint32_t reject, float &best_squared)
+{
+    return argminScalar(x, y, z, flags, n, px, py, pz, require, reject, best_squared);
+}
+
+#endif
+
+inline size_t argmin(const CubePositionsSoA &cubes, float px, float py, float pz, uint32_t require, uint32_t reject,
+                     float &best_squared)
+{
+    return argminSimd(cubes.x.data(), cubes.y.data(), cubes.z.data(), cubes.flags.data(), cubes.size(),
+                      px, py, pz, require, reject, best_squared);
+}
+
+} // namespace cube_distance
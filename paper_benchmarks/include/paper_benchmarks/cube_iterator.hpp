@@ -1,153 +1,210 @@
-#include <iostream>
+#pragma once
+
 #include <vector>
 #include <cmath>
-#include <random>
-#include <moveit/move_group_interface/move_group_interface.h> 
-
-typedef moveit_msgs::msg::CollisionObject CollisionObject;
-
-struct Point3D {
-    float x;
-    float y;
-    float z;
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <algorithm>
+#include <moveit/move_group_interface/move_group_interface.h>
+#include "paper_benchmarks/cube_selector.hpp"
+
+// Non-owning view over a contiguous block of cubes.
+class CubeSpan
+{
+private:
+    const CollisionObject *first;
+    size_t count;
 
-    // Constructor
-    Point3D(float px, float py, float pz) : x(px), y(py), z(pz) {}
+public:
+    CubeSpan() : first(nullptr), count(0) {}
+    CubeSpan(const CollisionObject *data, size_t size) : first(data), count(size) {}
+    CubeSpan(const std::vector<CollisionObject> &cubes) : first(cubes.data()), count(cubes.size()) {}
+
+    const CollisionObject *begin() const { return first; }
+    const CollisionObject *end() const { return first + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const CollisionObject &operator[](size_t i) const { return first[i]; }
 };
 
-template<typename Policy>
-class CubeIterator;
+// A policy maps a cube to an ordering key; cubes are visited by increasing
+// key and, for equal keys, in span order.
+struct EuclideanDistancePolicy
+{
+    static float distance(const CollisionObject &cube, const Point3D &point)
+    {
+        return std::sqrt(key(cube, point));
+    }
 
-struct EuclideanDistancePolicy{
-    static float distance(const CollisionObject &cube, const Point3D &point){
+    // squared distance, ordering-equivalent to distance() without the sqrt
+    static float key(const CollisionObject &cube, const Point3D &point)
+    {
         float dx = cube.pose.position.x - point.x;
         float dy = cube.pose.position.y - point.y;
         float dz = cube.pose.position.z - point.z;
-        return std::sqrt(dx * dx + dy * dy + dz * dz);
+        return dx * dx + dy * dy + dz * dz;
     }
 };
 
-struct RandomCubePolicy{
-    static int getRandomCube(size_t size){
-        // explicit randomization is not necessary since already the cubes are randomized
-
-        //CollisionObject cube = cubes.front();
-        //cubes.erase(cubes.begin());
-        //std::random_device rd;
-        //std::mt19937 gen(rd());
-        //std::uniform_int_distribution<> dist(0, size); // Modify the range as needed
-
-        //int index  = dist(gen);
-
+struct RandomCubePolicy
+{
+    // explicit randomization is not necessary since already the cubes are
+    // randomized, so cubes are visited in their stored order
+    static float key(const CollisionObject &, const Point3D &)
+    {
         return 0;
     }
 };
 
-
-template<typename Policy>
-class CubeIterator{
-
+// Range visiting the cubes of a span in Policy order. Construction computes
+// the keys and heapifies them in O(n); each step that reaches a cube not yet
+// visited pops one entry off the heap in O(log n), so taking the first k
+// cubes costs O(n + k log n) and a full traversal O(n log n). All buffers
+// are sized up front, so iteration never allocates. The order is
+// materialised lazily into a prefix shared by all iterators of the range,
+// which keeps them multi-pass. Iterating advances that prefix, so only a
+// non-const range can be iterated, and not from several threads at once.
+template <typename Policy>
+class CubeRange
+{
 private:
-    const std::vector<CollisionObject> points;
-    size_t currentIndex;
-    const Point3D endEffector;
-    float previous_min;
-    float counter;
+    struct Entry
+    {
+        float key;
+        uint32_t index;
+
+        // std heap functions build a max-heap, so invert the comparison
+        bool operator<(const Entry &other) const
+        {
+            return key > other.key || (key == other.key && index > other.index);
+        }
+    };
+
+    CubeSpan cubes;
+    std::vector<Entry> heap;
+    std::vector<uint32_t> order;
+
+    void materialise(size_t position)
+    {
+        while (order.size() <= position && !heap.empty())
+        {
+            std::pop_heap(heap.begin(), heap.end());
+            order.push_back(heap.back().index);
+            heap.pop_back();
+        }
+    }
 
 public:
-    CubeIterator(const std::vector<CollisionObject> p, const Point3D e, 
-        size_t index = 0): points(p), currentIndex(index), endEffector(e), previous_min(0), counter(0){}
+    class iterator
+    {
+    private:
+        CubeRange *range;
+        size_t position;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef CollisionObject value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const CollisionObject *pointer;
+        typedef const CollisionObject &reference;
+
+        iterator() : range(nullptr), position(0) {}
+        iterator(CubeRange *r, size_t p) : range(r), position(p) {}
+
+        reference operator*() const
+        {
+            return range->cubes[index()];
+        }
 
-    //Dereferece operator
-    const CollisionObject& operator*(){
-        return points[currentIndex];
-    }
+        pointer operator->() const
+        {
+            return &**this;
+        }
 
-    //pre-increment operator
-    CubeIterator& operator++(){
-        if constexpr(std::is_same_v<Policy, RandomCubePolicy>){
-            //int index = Policy::getRandomCube(points.size());
-            currentIndex++;
-
-        }else{
-            float minDistance = std::numeric_limits<float>::max();
-            size_t nextIndex = currentIndex;
-
-            for(size_t i=0; i < points.size(); ++i){
-                if(i == currentIndex) continue; 
-
-                float distance = Policy::distance(points[i], endEffector);
-                std::cout << "distance    " << distance << std::endl;
-                if(distance > previous_min){
-                    if(distance < minDistance){
-                        minDistance = distance;
-                        nextIndex = i;
-                    }
-                }
-            }
-            counter++;
-            currentIndex = nextIndex;
-            previous_min = Policy::distance(points[currentIndex], endEffector);
-            std::cout << "current    " << currentIndex << std::endl;
+        // position of the current cube in the underlying span
+        size_t index() const
+        {
+            range->materialise(position);
+            return range->order[position];
+        }
 
+        iterator &operator++()
+        {
+            ++position;
+            return *this;
         }
 
-        return *this;
-    }
-    
-    //post-increment operator
-    // CubeIterator& operator++(int){
-    //     CubeIterator temp = *this;
-    //     ++(*this);
-    //     return temp;
-    // }
-
-    // Equality operator
-    bool operator==(const CubeIterator& other) const {
-        return currentIndex == other.currentIndex;
+        iterator operator++(int)
+        {
+            iterator temp = *this;
+            ++position;
+            return temp;
+        }
+
+        bool operator==(const iterator &other) const
+        {
+            return position == other.position;
+        }
+
+        bool operator!=(const iterator &other) const
+        {
+            return position != other.position;
+        }
+    };
+
+    CubeRange(CubeSpan span, const Point3D &endEffector) : cubes(span)
+    {
+        heap.reserve(cubes.size());
+        order.reserve(cubes.size());
+        for (size_t i = 0; i < cubes.size(); ++i)
+        {
+            heap.push_back(Entry{Policy::key(cubes[i], endEffector), static_cast<uint32_t>(i)});
+        }
+        std::make_heap(heap.begin(), heap.end());
     }
 
-    // Inequality operator
-    bool operator!=(const CubeIterator& other) const {
-        return currentIndex != other.currentIndex;
+    iterator begin()
+    {
+        return iterator(this, 0);
     }
 
-};
+    iterator end()
+    {
+        return iterator(this, cubes.size());
+    }
 
+    size_t size() const
+    {
+        return cubes.size();
+    }
 
-class CubeContainer{
+    bool empty() const
+    {
+        return cubes.empty();
+    }
+};
 
+class CubeContainer
+{
 private:
     std::vector<moveit_msgs::msg::CollisionObject> cubes;
 
 public:
-    void addCubes(moveit_msgs::msg::CollisionObject cube){
+    void addCubes(moveit_msgs::msg::CollisionObject cube)
+    {
         cubes.emplace_back(cube);
     }
 
-    CubeIterator<RandomCubePolicy> beginRandom(const Point3D e){
-        return CubeIterator<RandomCubePolicy>(cubes, e);
+    // The returned ranges refer to the container's storage and are
+    // invalidated by addCubes().
+    CubeRange<RandomCubePolicy> random(const Point3D e) const
+    {
+        return CubeRange<RandomCubePolicy>(cubes, e);
     }
 
-    CubeIterator<RandomCubePolicy> endRandom(const Point3D e){
-        return CubeIterator<RandomCubePolicy>(cubes, e, cubes.size());
+    CubeRange<EuclideanDistancePolicy> euclidean(const Point3D e) const
+    {
+        return CubeRange<EuclideanDistancePolicy>(cubes, e);
     }
-
-    CubeIterator<EuclideanDistancePolicy> beginEuclidean(const Point3D e){
-        return CubeIterator<EuclideanDistancePolicy>(cubes, e);
-    }
-
-    CubeIterator<EuclideanDistancePolicy> endEuclidean(const Point3D e){
-        size_t current_index = 0;
-        float maxDistance = 0;
-
-        for(size_t i=0; i < cubes.size(); ++i){
-            float distance = EuclideanDistancePolicy::distance(cubes[i], e);
-            if(distance > maxDistance){
-                maxDistance = distance;
-                current_index = i;
-            }
-        }
-        return CubeIterator<EuclideanDistancePolicy>(cubes, e, current_index);
-    }
-};
\ No newline at end of file
+};
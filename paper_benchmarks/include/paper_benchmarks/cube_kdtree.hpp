@@ -0,0 +1,280 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <cstddef>
+#include <algorithm>
+
+// Dynamic 3D k-d tree used as the spatial index of the cube queue.
+// Entries are identified by a caller owned slot id. Removal marks the node
+// dead and keeps per-subtree live counts, so empty subtrees are pruned
+// during the search. The tree is rebuilt balanced once it becomes too deep
+// or too many dead nodes accumulate, which keeps insert, erase and
+// nearest-neighbour queries at amortised O(log n).
+class CubeKdTree
+{
+private:
+    struct Node
+    {
+        float p[3];
+        size_t slot;
+        int left;
+        int right;
+        int parent;
+        int axis;
+        bool alive;
+        size_t alive_count;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> node_of_slot;
+    int root = -1;
+    size_t live = 0;
+    int max_depth = 0;
+
+    static float squaredDistance(const float *a, const float *b)
+    {
+        float dx = a[0] - b[0];
+        float dy = a[1] - b[1];
+        float dz = a[2] - b[2];
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    int depthLimit() const
+    {
+        // allow a slack of 2 * log2(n) + 4 before rebalancing
+        int limit = 4;
+        for (size_t n = nodes.size(); n > 1; n >>= 1)
+        {
+            limit += 2;
+        }
+        return limit;
+    }
+
+    int build(std::vector<int> &order, size_t begin, size_t end, int parent, int depth)
+    {
+        if (begin >= end)
+        {
+            return -1;
+        }
+
+        max_depth = std::max(max_depth, depth);
+
+        // split along the axis with the widest spread
+        float lo[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+        float hi[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+        for (size_t i = begin; i < end; ++i)
+        {
+            for (int a = 0; a < 3; ++a)
+            {
+                lo[a] = std::min(lo[a], nodes[order[i]].p[a]);
+                hi[a] = std::max(hi[a], nodes[order[i]].p[a]);
+            }
+        }
+        int axis = 0;
+        for (int a = 1; a < 3; ++a)
+        {
+            if (hi[a] - lo[a] > hi[axis] - lo[axis])
+            {
+                axis = a;
+            }
+        }
+
+        size_t mid = begin + (end - begin) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                         [this, axis](int a, int b)
+                         { return nodes[a].p[axis] < nodes[b].p[axis]; });
+
+        int n = order[mid];
+        nodes[n].axis = axis;
+        nodes[n].parent = parent;
+        nodes[n].left = build(order, begin, mid, n, depth + 1);
+        nodes[n].right = build(order, mid + 1, end, n, depth + 1);
+        nodes[n].alive_count = 1;
+        if (nodes[n].left >= 0)
+            nodes[n].alive_count += nodes[nodes[n].left].alive_count;
+        if (nodes[n].right >= 0)
+            nodes[n].alive_count += nodes[nodes[n].right].alive_count;
+        return n;
+    }
+
+    void rebuild()
+    {
+        // compact the live nodes and build a balanced tree over them
+        std::vector<Node> compacted;
+        compacted.reserve(live);
+        for (const Node &n : nodes)
+        {
+            if (n.alive)
+            {
+                compacted.push_back(n);
+            }
+        }
+        nodes.swap(compacted);
+
+        std::fill(node_of_slot.begin(), node_of_slot.end(), -1);
+        std::vector<int> order(nodes.size());
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            order[i] = static_cast<int>(i);
+            node_of_slot[nodes[i].slot] = static_cast<int>(i);
+        }
+
+        max_depth = 0;
+        root = build(order, 0, order.size(), -1, 0);
+    }
+
+    template <typename Predicate>
+    void search(int n, const float *q, Predicate &accept, int &best, float &best_distance) const
+    {
+        if (n < 0 || nodes[n].alive_count == 0)
+        {
+            return;
+        }
+
+        const Node &node = nodes[n];
+        if (node.alive && accept(node.slot))
+        {
+            float distance = squaredDistance(node.p, q);
+            if (distance < best_distance)
+            {
+                best_distance = distance;
+                best = n;
+            }
+        }
+
+        float diff = q[node.axis] - node.p[node.axis];
+        int near_child = diff < 0 ? node.left : node.right;
+        int far_child = diff < 0 ? node.right : node.left;
+
+        search(near_child, q, accept, best, best_distance);
+        if (diff * diff < best_distance)
+        {
+            search(far_child, q, accept, best, best_distance);
+        }
+    }
+
+public:
+    size_t size() const
+    {
+        return live;
+    }
+
+    void clear()
+    {
+        nodes.clear();
+        node_of_slot.clear();
+        root = -1;
+        live = 0;
+        max_depth = 0;
+    }
+
+    void insert(size_t slot, float x, float y, float z)
+    {
+        if (slot >= node_of_slot.size())
+        {
+            node_of_slot.resize(slot + 1, -1);
+        }
+
+        Node node;
+        node.p[0] = x;
+        node.p[1] = y;
+        node.p[2] = z;
+        node.slot = slot;
+        node.left = -1;
+        node.right = -1;
+        node.parent = -1;
+        node.axis = 0;
+        node.alive = true;
+        node.alive_count = 1;
+
+        int index = static_cast<int>(nodes.size());
+        nodes.push_back(node);
+        node_of_slot[slot] = index;
+        live++;
+
+        if (root < 0)
+        {
+            root = index;
+            max_depth = 0;
+            return;
+        }
+
+        // descend to a leaf, updating the live counts on the way
+        int current = root;
+        int depth = 1;
+        while (true)
+        {
+            Node &parent = nodes[current];
+            parent.alive_count++;
+            int &child = nodes[index].p[parent.axis] < parent.p[parent.axis] ? parent.left : parent.right;
+            if (child < 0)
+            {
+                child = index;
+                nodes[index].parent = current;
+                nodes[index].axis = (parent.axis + 1) % 3;
+                break;
+            }
+            current = child;
+            depth++;
+        }
+
+        max_depth = std::max(max_depth, depth);
+        if (max_depth > depthLimit())
+        {
+            rebuild();
+        }
+    }
+
+    void erase(size_t slot)
+    {
+        if (slot >= node_of_slot.size() || node_of_slot[slot] < 0)
+        {
+            return;
+        }
+
+        int n = node_of_slot[slot];
+        node_of_slot[slot] = -1;
+        nodes[n].alive = false;
+        live--;
+
+        for (int current = n; current >= 0; current = nodes[current].parent)
+        {
+            nodes[current].alive_count--;
+        }
+
+        if (live == 0)
+        {
+            clear();
+        }
+        else if (nodes.size() > 2 * live + 16)
+        {
+            rebuild();
+        }
+    }
+
+    // Finds the live entry closest to (x, y, z) for which accept(slot) holds.
+    // Returns false if no such entry exists.
+    template <typename Predicate>
+    bool nearest(float x, float y, float z, Predicate accept, size_t &slot, float &squared_distance) const
+    {
+        float q[3] = {x, y, z};
+        int best = -1;
+        float best_distance = std::numeric_limits<float>::max();
+        search(root, q, accept, best, best_distance);
+        if (best < 0)
+        {
+            return false;
+        }
+        slot = nodes[best].slot;
+        squared_distance = best_distance;
+        return true;
+    }
+
+    bool nearest(float x, float y, float z, size_t &slot) const
+    {
+        float squared_distance;
+        return nearest(x, y, z, [](size_t) { return true; }, slot, squared_distance);
+    }
+};
@@ -7,7 +7,13 @@
 #include <queue>
 #include <cstdlib>
 #include <limits>
+#include <mutex>
+#include <string>
+#include <memory>
 #include <moveit/move_group_interface/move_group_interface.h>
+#include "paper_benchmarks/cube_kdtree.hpp"
+#include "paper_benchmarks/cube_distance_kernel.hpp"
+#include "paper_benchmarks/reachability_map.hpp"
 
 typedef moveit_msgs::msg::CollisionObject CollisionObject;
 
@@ -27,7 +33,7 @@ struct CollisionPlanningObject
     int robot_1_planned_times;
     int robot_2_planned_times;
 
-    CollisionPlanningObject() {}
+    CollisionPlanningObject() : robot_1_planned_times(0), robot_2_planned_times(0) {}
 
     CollisionPlanningObject(CollisionObject c, int r_1, int r_2) : collisionObject(c), robot_1_planned_times(r_1), robot_2_planned_times(r_2) {}
 
@@ -43,19 +49,210 @@ struct CollisionPlanningObject
     }
 };
 
+// Copy of a queued cube handed out by peekNearest() and redeemed with
+// claim(). The shard index is filled in by ShardedCubeQueue.
+struct CubeCandidate
+{
+    size_t shard;
+    size_t slot;
+    CollisionPlanningObject cube;
+};
+
 class ThreadSafeCubeQueue
 {
 private:
-    std::vector<CollisionPlanningObject> priority_queue;
+    // below this many cubes a vectorized scan of the position mirror beats
+    // walking the k-d tree (see cube_selector_benchmark)
+    static constexpr size_t linear_scan_limit = 256;
+
+    // with a reachability map, this many nearest reachable cubes are ranked
+    // by distance weighted with their reachability score
+    static constexpr size_t reachability_candidates = 8;
+
+    // cubes are stored in stable slots; the k-d tree indexes slot ids,
+    // positions mirrors the slot positions and flags in packed arrays, and
+    // live_slots keeps a dense list of occupied slots for the random mode
+    std::vector<CollisionPlanningObject> slots;
+    CubePositionsSoA positions;
+    std::vector<size_t> free_slots;
+    std::vector<size_t> live_slots;
+    std::vector<size_t> live_position;
+    CubeKdTree index;
+    std::shared_ptr<const ReachabilityMap> reachability[2];
     Point3D point;
     mutable std::mutex mutex;
 
-    float calculateEuclideanDistance(const CollisionObject &cube, const Point3D &point) const
+    static int &plannedTimes(CollisionPlanningObject &cube, const std::string &robot_planning)
+    {
+        return robot_planning == "robot_1" ? cube.robot_1_planned_times : cube.robot_2_planned_times;
+    }
+
+    static uint32_t exhaustedFlag(const std::string &robot_planning)
+    {
+        return robot_planning == "robot_1" ? CubePositionsSoA::ROBOT_1_EXHAUSTED : CubePositionsSoA::ROBOT_2_EXHAUSTED;
+    }
+
+    static uint32_t unreachableFlag(const std::string &robot_planning)
+    {
+        return robot_planning == "robot_1" ? CubePositionsSoA::ROBOT_1_UNREACHABLE : CubePositionsSoA::ROBOT_2_UNREACHABLE;
+    }
+
+    static size_t robotIndex(const std::string &robot_planning)
+    {
+        return robot_planning == "robot_1" ? 0 : 1;
+    }
+
+    uint32_t reachabilityFlags(float x, float y, float z) const
+    {
+        uint32_t flags = 0;
+        if (reachability[0] && !reachability[0]->reachable(x, y, z))
+            flags |= CubePositionsSoA::ROBOT_1_UNREACHABLE;
+        if (reachability[1] && !reachability[1]->reachable(x, y, z))
+            flags |= CubePositionsSoA::ROBOT_2_UNREACHABLE;
+        return flags;
+    }
+
+    uint32_t flagsOf(const CollisionPlanningObject &cube) const
+    {
+        const auto &position = cube.collisionObject.pose.position;
+        uint32_t flags = CubePositionsSoA::LIVE | reachabilityFlags(position.x, position.y, position.z);
+        if (cube.robot_1_planned_times >= 5)
+            flags |= CubePositionsSoA::ROBOT_1_EXHAUSTED;
+        if (cube.robot_2_planned_times >= 5)
+            flags |= CubePositionsSoA::ROBOT_2_EXHAUSTED;
+        return flags;
+    }
+
+    bool nearestSlot(const Point3D &p, uint32_t reject, size_t &slot) const
+    {
+        if (live_slots.size() <= linear_scan_limit)
+        {
+            float squared_distance;
+            slot = cube_distance::argmin(positions, p.x, p.y, p.z, CubePositionsSoA::LIVE, reject, squared_distance);
+            return slot < positions.size();
+        }
+
+        float squared_distance;
+        auto accept = [this, reject](size_t candidate)
+        {
+            return (positions.flags[candidate] & reject) == 0;
+        };
+        return index.nearest(p.x, p.y, p.z, accept, slot, squared_distance);
+    }
+
+    // up to k nearest slots passing the reject mask, nearest first
+    std::vector<size_t> nearestSlots(const Point3D &p, uint32_t reject, size_t k)
+    {
+        std::vector<size_t> found;
+        size_t slot;
+        while (found.size() < k && nearestSlot(p, reject | CubePositionsSoA::RESERVED, slot))
+        {
+            positions.flags[slot] |= CubePositionsSoA::RESERVED;
+            found.push_back(slot);
+        }
+        for (size_t s : found)
+        {
+            positions.flags[s] &= ~static_cast<uint32_t>(CubePositionsSoA::RESERVED);
+        }
+        return found;
+    }
+
+    // picks among the nearest candidates the one with the best ratio of
+    // distance to reachability score
+    bool bestReachableSlot(const Point3D &p, uint32_t reject, const ReachabilityMap &map, size_t &slot)
+    {
+        float best_rank = std::numeric_limits<float>::max();
+        bool found = false;
+        for (size_t candidate : nearestSlots(p, reject, reachability_candidates))
+        {
+            float dx = positions.x[candidate] - p.x;
+            float dy = positions.y[candidate] - p.y;
+            float dz = positions.z[candidate] - p.z;
+            float score = map.score(positions.x[candidate], positions.y[candidate], positions.z[candidate]) / 255.f;
+            float rank = std::sqrt(dx * dx + dy * dy + dz * dz) / (0.5f + 0.5f * score);
+            if (rank < best_rank)
+            {
+                best_rank = rank;
+                slot = candidate;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    CollisionPlanningObject take(size_t slot)
+    {
+        index.erase(slot);
+        positions.flags[slot] = 0;
+
+        size_t position = live_position[slot];
+        live_slots[position] = live_slots.back();
+        live_position[live_slots[position]] = position;
+        live_slots.pop_back();
+
+        free_slots.push_back(slot);
+        return std::move(slots[slot]);
+    }
+
+    CollisionPlanningObject popLocked(const std::string &robot_planning, const std::string &s, const Point3D &p)
     {
-        float dx = cube.pose.position.x - point.x;
-        float dy = cube.pose.position.y - point.y;
-        float dz = cube.pose.position.z - point.z;
-        return std::sqrt(dx * dx + dy * dy + dz * dz);
+        if (live_slots.empty())
+        {
+            return CollisionPlanningObject();
+        }
+
+        int result = s.compare("random");
+        if (result == 0)
+        {
+            int randomNum = std::rand() % (live_slots.size());
+            std::cout << "Generating random " << randomNum << " " << live_slots.size() << std::endl;
+            if (robot_planning.empty() || !reachability[robotIndex(robot_planning)])
+            {
+                return take(live_slots[randomNum]);
+            }
+
+            // skip ahead to the next cube the robot can reach
+            uint32_t unreachable = unreachableFlag(robot_planning);
+            for (size_t i = 0; i < live_slots.size(); ++i)
+            {
+                size_t candidate = live_slots[(randomNum + i) % live_slots.size()];
+                if (!(positions.flags[candidate] & unreachable))
+                {
+                    return take(candidate);
+                }
+            }
+            return CollisionPlanningObject();
+        }
+
+        size_t slot = live_slots.front();
+
+        // empty case for baseline synchronous planning.
+        if (robot_planning.empty())
+        {
+            nearestSlot(p, 0, slot);
+            return take(slot);
+        }
+
+        uint32_t exhausted = exhaustedFlag(robot_planning);
+        const ReachabilityMap *map = reachability[robotIndex(robot_planning)].get();
+        if (map)
+        {
+            // never hand out a cube the robot cannot reach
+            uint32_t unreachable = unreachableFlag(robot_planning);
+            if (!bestReachableSlot(p, exhausted | unreachable, *map, slot) &&
+                !bestReachableSlot(p, unreachable, *map, slot))
+            {
+                return CollisionPlanningObject();
+            }
+        }
+        else if (!nearestSlot(p, exhausted, slot))
+        {
+            nearestSlot(p, 0, slot);
+        }
+
+        CollisionPlanningObject minObject = take(slot);
+        plannedTimes(minObject, robot_planning)++;
+        return minObject;
     }
 
 public:
@@ -67,19 +264,62 @@ public:
     void push(CollisionPlanningObject &cube)
     {
         std::lock_guard<std::mutex> lock(mutex);
-        priority_queue.push_back(cube);
+        size_t slot;
+        if (free_slots.empty())
+        {
+            slot = slots.size();
+            slots.push_back(cube);
+            live_position.push_back(0);
+        }
+        else
+        {
+            slot = free_slots.back();
+            free_slots.pop_back();
+            slots[slot] = cube;
+        }
+
+        live_position[slot] = live_slots.size();
+        live_slots.push_back(slot);
+
+        const auto &position = cube.collisionObject.pose.position;
+        positions.set(slot, position.x, position.y, position.z, flagsOf(cube));
+        index.insert(slot, position.x, position.y, position.z);
     }
 
     bool empty() const
     {
         std::lock_guard<std::mutex> lock(mutex);
-        return priority_queue.empty();
+        return live_slots.empty();
     }
 
     size_t size() const
     {
         std::lock_guard<std::mutex> lock(mutex);
-        return priority_queue.size();
+        return live_slots.size();
+    }
+
+    // Installs the reachability map of a robot ("robot_1" or "robot_2").
+    // Cubes outside the map's reachable voxels are then never handed to it.
+    void setReachability(const std::string &robot_planning, std::shared_ptr<const ReachabilityMap> map)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        reachability[robotIndex(robot_planning)] = map;
+
+        uint32_t mask = CubePositionsSoA::ROBOT_1_UNREACHABLE | CubePositionsSoA::ROBOT_2_UNREACHABLE;
+        for (size_t slot : live_slots)
+        {
+            positions.flags[slot] = (positions.flags[slot] & ~mask) |
+                                    reachabilityFlags(positions.x[slot], positions.y[slot], positions.z[slot]);
+        }
+    }
+
+    // false if a reachability map is installed for the robot and the cube
+    // lies outside its reachable voxels
+    bool reachable(const std::string &robot_planning, const CollisionObject &cube) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto &map = reachability[robotIndex(robot_planning)];
+        return !map || map->reachable(cube.pose.position.x, cube.pose.position.y, cube.pose.position.z);
     }
 
     void updatePoint(const Point3D &p)
@@ -88,69 +328,64 @@ public:
         point = p;
     }
 
+    // Removes and returns a cube. With s == "random" a uniformly random cube
+    // is returned, otherwise the cube nearest to the current point. For a
+    // named robot, cubes that robot already planned for 5 times are skipped
+    // unless nothing else is left. An empty queue yields an object with an
+    // empty id.
     CollisionPlanningObject pop(std::string robot_planning, std::string s)
     {
-        int result = s.compare("random");
-        if (result == 0)
-        {
-            std::lock_guard<std::mutex> lock(mutex);
-            int randomNum = std::rand() % (priority_queue.size());
-            std::cout << "Generating random " << randomNum << " " << priority_queue.size() << std::endl;
-            CollisionPlanningObject minObject = priority_queue[randomNum];
-            priority_queue.erase(priority_queue.begin() + randomNum);
-            return minObject;
-        }
-        // empty case for baseline synchronous planning.
-        if (robot_planning.empty())
-        {
-            std::lock_guard<std::mutex> lock(mutex);
-            size_t current_index = 0;
-            float minDistance = std::numeric_limits<float>::max();
+        std::lock_guard<std::mutex> lock(mutex);
+        return popLocked(robot_planning, s, point);
+    }
 
-            for (size_t i = 0; i < priority_queue.size(); ++i)
+    // Returns copies of up to k cubes nearest to p, nearest first, without
+    // removing them. Cubes robot_planning has exhausted are left out.
+    std::vector<CubeCandidate> peekNearest(const Point3D &p, size_t k, const std::string &robot_planning)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t reject = 0;
+        if (!robot_planning.empty())
+        {
+            reject |= exhaustedFlag(robot_planning);
+            if (reachability[robotIndex(robot_planning)])
             {
-                float distance = calculateEuclideanDistance(priority_queue[i].collisionObject, point);
-                if (distance < minDistance)
-                {
-                    minDistance = distance;
-                    current_index = i;
-                }
+                reject |= unreachableFlag(robot_planning);
             }
-
-            CollisionPlanningObject minObject = priority_queue[current_index];
-            priority_queue.erase(priority_queue.begin() + current_index);
-            return minObject;
         }
 
-        std::lock_guard<std::mutex> lock(mutex);
-        size_t current_index = 0;
-        float minDistance = std::numeric_limits<float>::max();
-
-        for (size_t i = 0; i < priority_queue.size(); ++i)
+        std::vector<CubeCandidate> candidates;
+        for (size_t slot : nearestSlots(p, reject, k))
         {
-            float distance = calculateEuclideanDistance(priority_queue[i].collisionObject, point);
-            if (distance < minDistance)
-            {
-                if (robot_planning.compare("robot_1") && priority_queue[i].robot_1_planned_times >= 5 ||
-                    robot_planning.compare("robot_2") && priority_queue[i].robot_2_planned_times >= 5)
-                {
-                    continue;
-                }
-                minDistance = distance;
-                current_index = i;
-            }
+            candidates.push_back(CubeCandidate{0, slot, slots[slot]});
         }
+        return candidates;
+    }
 
-        CollisionPlanningObject minObject = priority_queue[current_index];
-        if (robot_planning.compare("robot_1"))
+    // Removes a cube previously returned by peekNearest(). Fails if the cube
+    // has been popped in the meantime.
+    bool claim(const CubeCandidate &candidate, const std::string &robot_planning, CollisionPlanningObject &cube)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (candidate.slot >= slots.size() || !(positions.flags[candidate.slot] & CubePositionsSoA::LIVE) ||
+            slots[candidate.slot].collisionObject.id != candidate.cube.collisionObject.id)
         {
-            minObject.robot_1_planned_times++;
+            return false;
         }
-        else
+
+        cube = take(candidate.slot);
+        if (!robot_planning.empty())
         {
-            minObject.robot_2_planned_times++;
+            plannedTimes(cube, robot_planning)++;
         }
-        priority_queue.erase(priority_queue.begin() + current_index);
-        return minObject;
+        return true;
+    }
+
+    // Same as pop() but searches around p instead of the stored point, so
+    // the query point and the removal happen under a single lock.
+    CollisionPlanningObject pop(std::string robot_planning, std::string s, const Point3D &p)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return popLocked(robot_planning, s, p);
     }
-};
\ No newline at end of file
+};
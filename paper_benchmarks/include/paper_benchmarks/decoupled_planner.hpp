@@ -0,0 +1,227 @@
+#pragma once
+
+#include <rclcpp/rclcpp.hpp>
+#include <moveit/move_group_interface/move_group_interface.h>
+#include <moveit/robot_state/robot_state.h>
+#include <moveit/robot_state/conversions.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/trajectory_processing/time_optimal_trajectory_generation.h>
+#include <moveit_msgs/msg/robot_state.hpp>
+#include <moveit_msgs/msg/robot_trajectory.hpp>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Plans the two arms one after the other instead of searching the 14
+// dimensional dual_arm space. The first arm is planned on its own with the
+// second one standing where it is. The second arm is planned towards its
+// goal with the first arm standing at its goal. The two trajectories are
+// then merged into one dual_arm trajectory, with the second arm's start
+// delayed in steps until the merged path is collision free. This way the
+// first arm's motion is a moving obstacle in time for the second arm. The
+// move group planners cannot plan around a moving obstacle, so the second
+// arm's path is fixed and only its timing is searched. The merged path is
+// timed again as a whole, which keeps the configurations of the two arms
+// relative to each other, so it stays collision free, and it is executed
+// as one trajectory.
+class DecoupledPlanner
+{
+public:
+    typedef moveit::planning_interface::MoveGroupInterface MoveGroupInterface;
+    typedef std::function<bool(const moveit_msgs::msg::RobotState &, const moveit_msgs::msg::RobotTrajectory &)> Validator;
+
+    struct Stats
+    {
+        size_t requests = 0;
+        size_t planned = 0;
+        size_t delayed = 0;
+        double planning_time = 0;
+        double delay = 0;
+    };
+
+private:
+    MoveGroupInterface &first;
+    MoveGroupInterface &second;
+    moveit::core::RobotModelConstPtr model;
+    std::string group;
+    double velocity_scaling;
+    double acceleration_scaling;
+    double delay_step;
+    double max_delay;
+    Validator validator;
+    std::mutex mutex;
+    Stats stats;
+
+    struct Timed
+    {
+        std::vector<std::string> names;
+        std::vector<std::vector<double>> positions;
+        std::vector<double> times;
+    };
+
+    static Timed timed(const moveit_msgs::msg::RobotTrajectory &trajectory)
+    {
+        Timed t;
+        t.names = trajectory.joint_trajectory.joint_names;
+        for (const auto &point : trajectory.joint_trajectory.points)
+        {
+            t.positions.push_back(point.positions);
+            t.times.push_back(rclcpp::Duration(point.time_from_start).seconds());
+        }
+        return t;
+    }
+
+    // joint values at `time`, held at the ends
+    static std::vector<double> at(const Timed &t, double time)
+    {
+        if (time <= t.times.front())
+            return t.positions.front();
+        if (time >= t.times.back())
+            return t.positions.back();
+
+        size_t i = std::upper_bound(t.times.begin(), t.times.end(), time) - t.times.begin();
+        double s = (time - t.times[i - 1]) / std::max(1e-9, t.times[i] - t.times[i - 1]);
+        std::vector<double> q(t.positions[i].size());
+        for (size_t j = 0; j < q.size(); ++j)
+        {
+            q[j] = t.positions[i - 1][j] + s * (t.positions[i][j] - t.positions[i - 1][j]);
+        }
+        return q;
+    }
+
+    // the two trajectories side by side, the second one starting `delay`
+    // seconds later, sampled at every waypoint of either and every `dt`
+    robot_trajectory::RobotTrajectory merge(const moveit::core::RobotState &start, const Timed &a, const Timed &b, double delay,
+                                            double dt = 0.05) const
+    {
+        std::vector<double> times(a.times);
+        for (double t : b.times)
+        {
+            times.push_back(t + delay);
+        }
+        double end = std::max(a.times.back(), b.times.back() + delay);
+        for (double t = 0; t < end; t += dt)
+        {
+            times.push_back(t);
+        }
+        times.push_back(end);
+        std::sort(times.begin(), times.end());
+        times.erase(std::unique(times.begin(), times.end(), [](double x, double y)
+                                { return y - x < 1e-6; }),
+                    times.end());
+
+        robot_trajectory::RobotTrajectory merged(model, group);
+        moveit::core::RobotState state(start);
+        for (double t : times)
+        {
+            state.setVariablePositions(a.names, at(a, t));
+            state.setVariablePositions(b.names, at(b, t - delay));
+            merged.addSuffixWayPoint(state, 0.0);
+        }
+        return merged;
+    }
+
+    static bool planArm(MoveGroupInterface &arm, const moveit::core::RobotState &start, const std::vector<double> &goal,
+                        MoveGroupInterface::Plan &plan)
+    {
+        arm.setStartState(start);
+        arm.setJointValueTarget(goal);
+        bool success = arm.plan(plan) == moveit::core::MoveItErrorCode::SUCCESS && !plan.trajectory_.joint_trajectory.points.empty();
+        arm.setStartStateToCurrentState();
+        return success;
+    }
+
+public:
+    DecoupledPlanner(MoveGroupInterface &first_arm, MoveGroupInterface &second_arm, const std::string &dual_group,
+                     double max_velocity_scaling = 1.0, double max_acceleration_scaling = 1.0, double step = 0.25,
+                     double max_delay_seconds = 5.0)
+        : first(first_arm), second(second_arm), model(first_arm.getRobotModel()), group(dual_group),
+          velocity_scaling(max_velocity_scaling), acceleration_scaling(max_acceleration_scaling), delay_step(step),
+          max_delay(max_delay_seconds)
+    {
+    }
+
+    // checks merged paths, e.g. against the planning scene; without one
+    // every merge is accepted
+    void setValidator(Validator check)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        validator = check;
+    }
+
+    // Plans both arms from `start` to their joint goals and writes the
+    // merged dual_arm trajectory to `plan`.
+    bool plan(const moveit::core::RobotState &start, const std::vector<double> &first_goal, const std::vector<double> &second_goal,
+              MoveGroupInterface::Plan &plan)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        Validator check;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            check = validator;
+            stats.requests++;
+        }
+
+        MoveGroupInterface::Plan first_plan, second_plan;
+        bool success = planArm(first, start, first_goal, first_plan);
+        if (success)
+        {
+            // the first arm is in the way at its goal for longest
+            moveit::core::RobotState second_start(start);
+            second_start.setVariablePositions(first_plan.trajectory_.joint_trajectory.joint_names,
+                                              first_plan.trajectory_.joint_trajectory.points.back().positions);
+            success = planArm(second, second_start, second_goal, second_plan);
+        }
+
+        double delay = 0;
+        if (success)
+        {
+            Timed a = timed(first_plan.trajectory_), b = timed(second_plan.trajectory_);
+            moveit_msgs::msg::RobotState start_msg;
+            moveit::core::robotStateToRobotStateMsg(start, start_msg);
+
+            success = false;
+            for (delay = 0; delay <= max_delay + 1e-9; delay += delay_step)
+            {
+                robot_trajectory::RobotTrajectory merged = merge(start, a, b, delay);
+                moveit_msgs::msg::RobotTrajectory merged_msg;
+                merged.getRobotTrajectoryMsg(merged_msg);
+                if (check && !check(start_msg, merged_msg))
+                    continue;
+
+                trajectory_processing::TimeOptimalTrajectoryGeneration totg(0.001, 0.02);
+                if (!totg.computeTimeStamps(merged, velocity_scaling, acceleration_scaling))
+                    break;
+                merged.getRobotTrajectoryMsg(plan.trajectory_);
+                plan.start_state_ = start_msg;
+                success = true;
+                break;
+            }
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        plan.planning_time_ = seconds;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.planning_time += seconds;
+        if (success)
+        {
+            stats.planned++;
+            if (delay > 0)
+            {
+                stats.delayed++;
+                stats.delay += delay;
+            }
+        }
+        return success;
+    }
+
+    Stats statistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <geometry_msgs/msg/pose.hpp>
+#include <moveit_msgs/msg/collision_object.hpp>
+#include <Eigen/Geometry>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <vector>
+#include "paper_benchmarks/primitive_pick_and_place.hpp"
+
+// The boxes are cubes, so a top-down grasp works equally well at four yaws
+// a quarter turn apart, and a cube goes into its tray slot at two yaws half
+// a turn apart. Always using the yaw of the box orientation can force a big
+// wrist rotation, or one past the joint 7 limit when the other yaws are in
+// reach. select_grasp() solves IK for every candidate and takes the
+// reachable one closest to the arm in joint space.
+
+// the pose turned by `angle` about the vertical through its position
+inline geometry_msgs::msg::Pose rotate_about_vertical(const geometry_msgs::msg::Pose &pose, double angle)
+{
+    Eigen::Quaterniond q(pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z);
+    q = Eigen::AngleAxisd(angle, Eigen::Vector3d::UnitZ()) * q;
+
+    geometry_msgs::msg::Pose rotated = pose;
+    rotated.orientation.x = q.x();
+    rotated.orientation.y = q.y();
+    rotated.orientation.z = q.z();
+    rotated.orientation.w = q.w();
+    return rotated;
+}
+
+// the `count` yaws of a pose spread evenly over a full turn, the pose itself
+// first
+inline std::vector<geometry_msgs::msg::Pose> symmetric_poses(const geometry_msgs::msg::Pose &pose, int count)
+{
+    std::vector<geometry_msgs::msg::Pose> poses;
+    for (int k = 0; k < count; ++k)
+    {
+        poses.push_back(k == 0 ? pose : rotate_about_vertical(pose, 2 * M_PI * k / count));
+    }
+    return poses;
+}
+
+// top-down grasps `height` above a box
+inline std::vector<geometry_msgs::msg::Pose> box_grasps(const moveit_msgs::msg::CollisionObject &object, double height)
+{
+    return symmetric_poses(approach_pose(object, height), 4);
+}
+
+// ways of setting a cube down at `pose` in a tray slot
+inline std::vector<geometry_msgs::msg::Pose> place_candidates(const geometry_msgs::msg::Pose &pose)
+{
+    return symmetric_poses(pose, 2);
+}
+
+// IK for a candidate; joint_values holds the solution on success
+typedef std::function<bool(const geometry_msgs::msg::Pose &, std::vector<double> &)> GraspIk;
+
+struct GraspChoice
+{
+    size_t index = 0;
+    std::vector<double> joint_values;
+    double distance = std::numeric_limits<double>::infinity();
+    size_t reachable = 0;
+};
+
+// Solves every candidate and picks the reachable one closest to `current`
+// in joint space, the earlier candidate on ties. False if none is reachable.
+inline bool select_grasp(const std::vector<geometry_msgs::msg::Pose> &candidates, const std::vector<double> &current,
+                         const GraspIk &ik, GraspChoice &choice)
+{
+    choice = GraspChoice();
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        std::vector<double> joint_values;
+        if (!ik(candidates[i], joint_values))
+        {
+            continue;
+        }
+        choice.reachable++;
+
+        double sum = 0;
+        for (size_t j = 0; j < joint_values.size() && j < current.size(); ++j)
+        {
+            sum += (joint_values[j] - current[j]) * (joint_values[j] - current[j]);
+        }
+        double distance = std::sqrt(sum);
+        if (distance < choice.distance)
+        {
+            choice.index = i;
+            choice.distance = distance;
+            choice.joint_values = joint_values;
+        }
+    }
+    return choice.reachable > 0;
+}
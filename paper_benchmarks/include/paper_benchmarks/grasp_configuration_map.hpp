@@ -0,0 +1,143 @@
+#pragma once
+
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+#include "paper_benchmarks/panda_analytic_ik.hpp"
+
+// Joint-space cost of reaching a point without solving IK for it. The
+// analytic IK is solved once for top-down flange poses at `height` above
+// link0, on a grid of `cell` spacing over the arm's reach, for
+// `yaw_samples` gripper yaws within a quarter turn and q7 every `q7_step`
+// over its range; every solution within the limits is kept, bucketed by
+// flange x/y. The cost of sending an arm to a point is the joint-space
+// distance from the arm's configuration to the nearest kept configuration
+// whose flange lies within `radius` of it. With the radius at least half a
+// cell diagonal every reachable point has grid nodes around it, so the
+// cost is infinite only where no top-down grasp exists. q7 turns the
+// gripper about the vertical and the cubes are symmetric under quarter
+// turns, so it is left out of the distance.
+class GraspConfigurationMap
+{
+private:
+    struct Entry
+    {
+        float x;
+        float y;
+        float q[6];
+    };
+
+    double cell;
+    double radius;
+    std::vector<Entry> entries;
+    // cell key -> first entry and count in entries, which is sorted by cell
+    std::unordered_map<int64_t, std::pair<uint32_t, uint32_t>> cells;
+
+    int64_t key(long cx, long cy) const
+    {
+        return (static_cast<int64_t>(cx) << 32) ^ static_cast<int64_t>(static_cast<uint32_t>(cy));
+    }
+
+    long cellOf(double v) const
+    {
+        return std::lround(std::floor(v / cell));
+    }
+
+public:
+    GraspConfigurationMap(double height, double cell_size = 0.02, double search_radius = 0.03, int yaw_samples = 4,
+                          double q7_step = 0.25, double reach = 0.9, const panda_ik::Limits &limits = panda_ik::Limits())
+        : cell(cell_size), radius(search_radius)
+    {
+        std::vector<std::pair<int64_t, Entry>> kept;
+        std::vector<panda_ik::Joints> solutions;
+        long steps = std::lround(std::ceil(reach / cell));
+        for (long ix = -steps; ix <= steps; ++ix)
+        {
+            for (long iy = -steps; iy <= steps; ++iy)
+            {
+                double x = ix * cell, y = iy * cell;
+                if (x * x + y * y > reach * reach)
+                    continue;
+                for (int k = 0; k < yaw_samples; ++k)
+                {
+                    // flange z axis pointing down
+                    Eigen::Isometry3d flange = Eigen::Translation3d(x, y, height) *
+                                               Eigen::AngleAxisd(M_PI / 2 * k / yaw_samples, Eigen::Vector3d::UnitZ()) *
+                                               Eigen::AngleAxisd(M_PI, Eigen::Vector3d::UnitX());
+                    for (double q7 = limits.lower[6]; q7 <= limits.upper[6]; q7 += q7_step)
+                    {
+                        solutions.clear();
+                        panda_ik::solve(flange, q7, limits, solutions);
+                        for (const panda_ik::Joints &q : solutions)
+                        {
+                            Entry entry;
+                            entry.x = static_cast<float>(x);
+                            entry.y = static_cast<float>(y);
+                            for (size_t j = 0; j < 6; ++j)
+                                entry.q[j] = static_cast<float>(q[j]);
+                            kept.emplace_back(key(cellOf(entry.x), cellOf(entry.y)), entry);
+                        }
+                    }
+                }
+            }
+        }
+
+        std::sort(kept.begin(), kept.end(), [](const std::pair<int64_t, Entry> &a, const std::pair<int64_t, Entry> &b)
+                  { return a.first < b.first; });
+        entries.reserve(kept.size());
+        for (size_t i = 0; i < kept.size(); ++i)
+        {
+            if (i == 0 || kept[i].first != kept[i - 1].first)
+                cells[kept[i].first] = std::make_pair(static_cast<uint32_t>(i), 0u);
+            cells[kept[i].first].second++;
+            entries.push_back(kept[i].second);
+        }
+    }
+
+    size_t size() const
+    {
+        return entries.size();
+    }
+
+    // joint-space distance from joint_values (7 joints) to the nearest kept
+    // configuration over (x, y) in the link0 frame; infinity if there is no
+    // top-down grasp there
+    double cost(const std::vector<double> &joint_values, double x, double y) const
+    {
+        if (joint_values.size() < 6)
+            return std::numeric_limits<double>::infinity();
+
+        float q[6];
+        for (size_t j = 0; j < 6; ++j)
+            q[j] = static_cast<float>(joint_values[j]);
+
+        float best = std::numeric_limits<float>::infinity();
+        const float r2 = static_cast<float>(radius * radius);
+        for (long cx = cellOf(x - radius); cx <= cellOf(x + radius); ++cx)
+        {
+            for (long cy = cellOf(y - radius); cy <= cellOf(y + radius); ++cy)
+            {
+                auto it = cells.find(key(cx, cy));
+                if (it == cells.end())
+                    continue;
+                const Entry *e = entries.data() + it->second.first;
+                for (uint32_t k = 0; k < it->second.second; ++k, ++e)
+                {
+                    float dx = e->x - static_cast<float>(x), dy = e->y - static_cast<float>(y);
+                    if (dx * dx + dy * dy > r2)
+                        continue;
+                    float d = 0;
+                    for (size_t j = 0; j < 6; ++j)
+                        d += (e->q[j] - q[j]) * (e->q[j] - q[j]);
+                    best = std::min(best, d);
+                }
+            }
+        }
+        return std::isfinite(best) ? std::sqrt(static_cast<double>(best)) : std::numeric_limits<double>::infinity();
+    }
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <cstddef>
+
+namespace hungarian
+{
+
+// Solves the rectangular assignment problem for a rows x cols cost matrix
+// stored row-major, rows <= cols. Returns for every row the column assigned
+// to it so that the summed cost is minimal. O(rows^2 * cols), using the
+// shortest augmenting path formulation with row/column potentials.
+inline std::vector<int> solve(const std::vector<double> &cost, size_t rows, size_t cols)
+{
+    const double inf = std::numeric_limits<double>::infinity();
+
+    // 1-based internally; column 0 is the virtual start column
+    std::vector<double> u(rows + 1, 0), v(cols + 1, 0);
+    std::vector<size_t> owner(cols + 1, 0), way(cols + 1, 0);
+
+    for (size_t row = 1; row <= rows; ++row)
+    {
+        owner[0] = row;
+        size_t column = 0;
+        std::vector<double> min_slack(cols + 1, inf);
+        std::vector<bool> used(cols + 1, false);
+        do
+        {
+            used[column] = true;
+            size_t r = owner[column];
+            size_t next = 0;
+            double delta = inf;
+            for (size_t c = 1; c <= cols; ++c)
+            {
+                if (used[c])
+                    continue;
+                double slack = cost[(r - 1) * cols + (c - 1)] - u[r] - v[c];
+                if (slack < min_slack[c])
+                {
+                    min_slack[c] = slack;
+                    way[c] = column;
+                }
+                if (min_slack[c] < delta)
+                {
+                    delta = min_slack[c];
+                    next = c;
+                }
+            }
+            for (size_t c = 0; c <= cols; ++c)
+            {
+                if (used[c])
+                {
+                    u[owner[c]] += delta;
+                    v[c] -= delta;
+                }
+                else
+                {
+                    min_slack[c] -= delta;
+                }
+            }
+            column = next;
+        } while (owner[column] != 0);
+
+        // flip the augmenting path
+        do
+        {
+            size_t previous = way[column];
+            owner[column] = owner[previous];
+            column = previous;
+        } while (column != 0);
+    }
+
+    std::vector<int> assignment(rows, -1);
+    for (size_t c = 1; c <= cols; ++c)
+    {
+        if (owner[c] != 0)
+        {
+            assignment[owner[c] - 1] = static_cast<int>(c - 1);
+        }
+    }
+    return assignment;
+}
+
+} // namespace hungarian
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/robot_state/robot_state.h>
+#include <geometry_msgs/msg/pose.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include "paper_benchmarks/parallel_ik.hpp"
+
+// IK for one arm without going through the move group. Every solve is
+// warm started from the previous solution of the arm, which is close to
+// the next target in a pick and place sequence, instead of waiting for a
+// fresh joint state first. Solutions are kept in an LRU keyed by the pose
+// quantised to `position_resolution` and `orientation_resolution`, so
+// recurring targets such as the tray slots and the approach heights above
+// a cube that is retried skip the solver. A cached solution is returned
+// as is only if the stored pose matches the request to within 1e-4;
+// otherwise it seeds the solver, which then converges in a few steps.
+// Misses go to a ParallelIk front-end if one is set, so that the cached
+// solution is the best of several rather than the first found.
+class IkService
+{
+public:
+    // upper edges in milliseconds, the last bucket takes everything slower
+    static const int histogram_buckets = 9;
+
+    struct Stats
+    {
+        size_t hits = 0;
+        size_t seeded = 0;
+        size_t misses = 0;
+        size_t failures = 0;
+        size_t histogram[histogram_buckets] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+        double solve_time = 0;
+
+        double hitRate() const
+        {
+            size_t total = hits + seeded + misses;
+            return total ? static_cast<double>(hits) / total : 0;
+        }
+    };
+
+private:
+    struct Entry
+    {
+        std::string key;
+        double pose[7];
+        std::vector<double> joint_values;
+    };
+
+    const moveit::core::JointModelGroup *jmg;
+    moveit::core::RobotState state;
+    double timeout;
+    size_t capacity;
+    double position_resolution;
+    double orientation_resolution;
+
+    std::mutex mutex;
+    std::list<Entry> lru;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    std::vector<double> last_solution;
+    std::shared_ptr<ParallelIk> parallel;
+    Stats stats;
+
+    // x, y, z and the quaternion with its sign fixed, q and -q being the
+    // same rotation
+    static void canonical(const geometry_msgs::msg::Pose &pose, double out[7])
+    {
+        double q[4] = {pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z};
+        double sign = 1;
+        for (double c : q)
+        {
+            if (std::fabs(c) > 1e-9)
+            {
+                sign = c < 0 ? -1 : 1;
+                break;
+            }
+        }
+        out[0] = pose.position.x;
+        out[1] = pose.position.y;
+        out[2] = pose.position.z;
+        for (int i = 0; i < 4; ++i)
+        {
+            out[3 + i] = sign * q[i];
+        }
+    }
+
+    std::string key(const double pose[7]) const
+    {
+        char buffer[160];
+        int n = 0;
+        for (int i = 0; i < 7; ++i)
+        {
+            double resolution = i < 3 ? position_resolution : orientation_resolution;
+            n += snprintf(buffer + n, sizeof(buffer) - n, "%ld:", std::lround(pose[i] / resolution));
+        }
+        return std::string(buffer, n);
+    }
+
+    void record(double milliseconds)
+    {
+        static const double edges[histogram_buckets - 1] = {0.5, 1, 2, 5, 10, 20, 50, 100};
+        int bucket = 0;
+        while (bucket < histogram_buckets - 1 && milliseconds >= edges[bucket])
+        {
+            bucket++;
+        }
+        stats.histogram[bucket]++;
+        stats.solve_time += milliseconds / 1000;
+    }
+
+    void remember(const std::string &k, const double pose[7], const std::vector<double> &joint_values)
+    {
+        auto it = index.find(k);
+        if (it != index.end())
+        {
+            lru.erase(it->second);
+            index.erase(it);
+        }
+        else if (lru.size() >= capacity)
+        {
+            index.erase(lru.back().key);
+            lru.pop_back();
+        }
+        Entry entry;
+        entry.key = k;
+        std::copy(pose, pose + 7, entry.pose);
+        entry.joint_values = joint_values;
+        lru.push_front(entry);
+        index[k] = lru.begin();
+    }
+
+public:
+    IkService(const moveit::core::RobotModelConstPtr &model, const moveit::core::JointModelGroup *group, double ik_timeout = 0.1,
+              size_t max_entries = 256, double position_quantisation = 0.001, double orientation_quantisation = 0.001)
+        : jmg(group), state(model), timeout(ik_timeout), capacity(max_entries), position_resolution(position_quantisation),
+          orientation_resolution(orientation_quantisation)
+    {
+        state.setToDefaultValues();
+    }
+
+    // the arm's configuration right now, for the first solve
+    void setSeed(const std::vector<double> &joint_values)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        last_solution = joint_values;
+    }
+
+    void setParallel(std::shared_ptr<ParallelIk> parallel_ik)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        parallel = parallel_ik;
+    }
+
+    bool hasSeed()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !last_solution.empty();
+    }
+
+    // Solves IK for `pose`. Seeds from `seed` if given, else from the last
+    // solution of this arm.
+    bool solve(const geometry_msgs::msg::Pose &pose, std::vector<double> &joint_values, const std::vector<double> *seed = nullptr)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        double p[7];
+        canonical(pose, p);
+        std::string k = key(p);
+
+        const std::vector<double> *start = seed && !seed->empty() ? seed : &last_solution;
+        auto it = index.find(k);
+        if (it != index.end())
+        {
+            Entry &entry = *it->second;
+            bool exact = true;
+            for (int i = 0; exact && i < 7; ++i)
+            {
+                exact = std::fabs(entry.pose[i] - p[i]) <= 1e-4;
+            }
+            lru.splice(lru.begin(), lru, it->second);
+            if (exact)
+            {
+                stats.hits++;
+                joint_values = entry.joint_values;
+                last_solution = joint_values;
+                return true;
+            }
+            stats.seeded++;
+            start = &entry.joint_values;
+        }
+        else
+        {
+            stats.misses++;
+        }
+
+        if (!start->empty())
+        {
+            state.setJointGroupPositions(jmg, *start);
+        }
+
+        // a nearby cached solution converges on its own, a miss is worth
+        // comparing several restarts for
+        bool use_parallel = parallel && it == index.end();
+        std::vector<double> reference;
+        state.copyJointGroupPositions(jmg, reference);
+
+        auto begin = std::chrono::steady_clock::now();
+        bool found = use_parallel ? parallel->solve(pose, reference, joint_values) : state.setFromIK(jmg, pose, timeout);
+        record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+
+        if (!found)
+        {
+            stats.failures++;
+            return false;
+        }
+
+        if (use_parallel)
+            state.setJointGroupPositions(jmg, joint_values);
+        else
+            state.copyJointGroupPositions(jmg, joint_values);
+        last_solution = joint_values;
+        remember(k, p, joint_values);
+        return true;
+    }
+
+    Stats statistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    // one line for the logs, e.g. "hits 12 seeded 3 misses 40 ..."
+    std::string summary()
+    {
+        Stats s = statistics();
+        static const char *labels[histogram_buckets] = {"<0.5", "<1", "<2", "<5", "<10", "<20", "<50", "<100", ">=100"};
+        char buffer[512];
+        int n = snprintf(buffer, sizeof(buffer), "hits %zu seeded %zu misses %zu failures %zu hit rate %.2f solve time %.3f s |",
+                         s.hits, s.seeded, s.misses, s.failures, s.hitRate(), s.solve_time);
+        for (int i = 0; i < histogram_buckets && n < static_cast<int>(sizeof(buffer)); ++i)
+        {
+            n += snprintf(buffer + n, sizeof(buffer) - n, " %sms:%zu", labels[i], s.histogram[i]);
+        }
+        return std::string(buffer);
+    }
+};
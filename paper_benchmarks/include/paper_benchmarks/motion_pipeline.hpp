@@ -0,0 +1,154 @@
+#pragma once
+
+#include <moveit/move_group_interface/move_group_interface.h>
+#include <moveit/robot_state/robot_state.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <vector>
+#include "paper_benchmarks/arm_executor.hpp"
+
+// Executes the motions of one move group in the background so the next one
+// can be planned meanwhile. The next plan starts where the motion in flight
+// is predicted to end, its last waypoint. At most two plans exist at a
+// time, the one executing and the one planned behind it. When the motion in
+// flight finishes, the state the robot actually ended in is compared to the
+// start of the next plan. If any joint is further off than `tolerance` the
+// next plan is thrown away and planned again from the actual state, e.g.
+// after an aborted execution.
+//
+// A MoveGroupInterface is not thread safe, so the motions are executed
+// through an interface of their own on the worker. The one given as
+// `planning` is only read for the current state, on the caller's thread,
+// which is also where the caller plans with it.
+class MotionPipeline
+{
+public:
+    typedef moveit::planning_interface::MoveGroupInterface MoveGroupInterface;
+    // plans from the given start state into the plan
+    typedef std::function<bool(const moveit::core::RobotState &, MoveGroupInterface::Plan &)> Planner;
+
+    struct Stats
+    {
+        size_t motions = 0;
+        size_t replanned = 0;
+        size_t failed = 0;
+        // planning done while a motion was executing
+        double overlapped_time = 0;
+        // time spent waiting for the motion in flight
+        double waiting_time = 0;
+    };
+
+private:
+    MoveGroupInterface &planning;
+    MoveGroupInterface &execution;
+    double tolerance;
+    ArmExecutor executor;
+    std::future<bool> in_flight;
+    // the last waypoint of the motion in flight
+    std::vector<std::string> end_names;
+    std::vector<double> end_positions;
+    std::chrono::steady_clock::time_point planning_started;
+    std::mutex mutex;
+    Stats stats;
+
+    bool deviates(const moveit::core::RobotState &actual) const
+    {
+        for (size_t i = 0; i < end_names.size(); ++i)
+        {
+            if (std::fabs(actual.getVariablePosition(end_names[i]) - end_positions[i]) > tolerance)
+                return true;
+        }
+        return false;
+    }
+
+public:
+    MotionPipeline(MoveGroupInterface &planning_group, MoveGroupInterface &execution_group, double joint_tolerance = 0.01)
+        : planning(planning_group), execution(execution_group), tolerance(joint_tolerance)
+    {
+    }
+
+    // The state to plan the next motion from: where the motion in flight
+    // ends, or the current state if nothing is executing.
+    moveit::core::RobotState predictedStart()
+    {
+        moveit::core::RobotState start(*planning.getCurrentState());
+        if (in_flight.valid())
+        {
+            start.setVariablePositions(end_names, end_positions);
+        }
+        planning_started = std::chrono::steady_clock::now();
+        return start;
+    }
+
+    // Waits for the motion in flight, false if its execution failed. True
+    // if nothing was executing.
+    bool wait()
+    {
+        if (!in_flight.valid())
+            return true;
+
+        auto begin = std::chrono::steady_clock::now();
+        bool success = in_flight.get();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.waiting_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        if (!success)
+            stats.failed++;
+        return success;
+    }
+
+    // Waits for the motion in flight and starts `plan`, which was planned
+    // from predictedStart(). It is replanned from the actual state with
+    // `replan` first if the robot did not end where predicted. False if
+    // that replanning fails; the motion in flight having failed alone does
+    // not count, as long as the replanned motion can start.
+    bool submit(MoveGroupInterface::Plan plan, const Planner &replan)
+    {
+        bool predicted = in_flight.valid();
+        if (predicted)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.overlapped_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - planning_started).count();
+        }
+        wait();
+
+        if (predicted)
+        {
+            moveit::core::RobotState actual(*planning.getCurrentState());
+            if (deviates(actual))
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stats.replanned++;
+                }
+                if (!replan(actual, plan))
+                    return false;
+            }
+        }
+
+        const auto &trajectory = plan.trajectory_.joint_trajectory;
+        if (trajectory.points.empty())
+            return false;
+        end_names = trajectory.joint_names;
+        end_positions = trajectory.points.back().positions;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.motions++;
+        }
+        MoveGroupInterface *g = &execution;
+        in_flight = executor.submit([g, plan]()
+                                    { return g->execute(plan) == moveit::core::MoveItErrorCode::SUCCESS; });
+        return true;
+    }
+
+    Stats statistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+};
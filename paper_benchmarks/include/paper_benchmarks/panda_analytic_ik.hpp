@@ -0,0 +1,228 @@
+#pragma once
+
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+// Closed-form IK of a single Panda arm from link0 to the flange (link8),
+// with the kinematic parameters of panda_description/urdf/panda_arm.xacro.
+// The arm has one redundant degree of freedom; fixing q7 leaves a 6-DOF
+// problem that is solved geometrically:
+//  - q7 and the flange pose give the origin and orientation of frame 6,
+//  - the distance between the shoulder (frame 2) and frame 6 gives q4,
+//  - frame 6 seen from the shoulder gives q5 and q6,
+//  - the remaining shoulder rotation is a ZYZ rotation, giving q1 q2 q3.
+// Every step has up to two branches, so one q7 yields up to 8 solutions.
+// The redundancy is resolved by sweeping q7 around a seed.
+namespace panda_ik
+{
+
+typedef std::array<double, 7> Joints;
+
+const double d1 = 0.333;
+const double d3 = 0.316;
+const double a4 = 0.0825;
+const double d5 = 0.384;
+const double a7 = 0.088;
+const double d_flange = 0.107;
+
+struct Limits
+{
+    // the soft limits of panda_arm.xacro, which MoveIt uses as bounds
+    Joints lower = {{-2.8973, -1.7628, -2.8973, -3.0718, -2.8973, -0.0175, -2.8973}};
+    Joints upper = {{2.8973, 1.7628, 2.8973, -0.0698, 2.8973, 3.7525, 2.8973}};
+
+    bool contains(const Joints &q) const
+    {
+        for (size_t i = 0; i < q.size(); ++i)
+        {
+            if (!(q[i] >= lower[i] && q[i] <= upper[i]))
+                return false;
+        }
+        return true;
+    }
+};
+
+// one step of the modified DH convention used by the Panda:
+// RotX(alpha) * TransX(a) * RotZ(theta) * TransZ(d)
+inline Eigen::Isometry3d dh(double a, double d, double alpha, double theta)
+{
+    Eigen::Isometry3d t = Eigen::Isometry3d::Identity();
+    t.rotate(Eigen::AngleAxisd(alpha, Eigen::Vector3d::UnitX()));
+    t.translate(Eigen::Vector3d(a, 0, 0));
+    t.rotate(Eigen::AngleAxisd(theta, Eigen::Vector3d::UnitZ()));
+    t.translate(Eigen::Vector3d(0, 0, d));
+    return t;
+}
+
+// flange pose in the link0 frame
+inline Eigen::Isometry3d forward(const Joints &q)
+{
+    return dh(0, d1, 0, q[0]) * dh(0, 0, -M_PI_2, q[1]) * dh(0, d3, M_PI_2, q[2]) * dh(a4, 0, M_PI_2, q[3]) *
+           dh(-a4, d5, -M_PI_2, q[4]) * dh(0, 0, M_PI_2, q[5]) * dh(a7, 0, M_PI_2, q[6]) * dh(0, d_flange, 0, 0);
+}
+
+// the angle plus a multiple of 2 pi that falls in [lower, upper], if any
+inline bool wrapInto(double &angle, double lower, double upper)
+{
+    angle = std::remainder(angle, 2 * M_PI);
+    for (double candidate : {angle, angle + 2 * M_PI, angle - 2 * M_PI})
+    {
+        if (candidate >= lower && candidate <= upper)
+        {
+            angle = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// All solutions with the given q7 that lie within the limits, appended to
+// `solutions`. `q1_singular` is used for q1 when the shoulder is stretched
+// (q2 = 0) and only q1 + q3 is determined.
+inline size_t solve(const Eigen::Isometry3d &flange, double q7, const Limits &limits, std::vector<Joints> &solutions,
+                    double q1_singular = 0)
+{
+    const double eps = 1e-9;
+    size_t found = 0;
+    if (q7 < limits.lower[6] || q7 > limits.upper[6])
+        return 0;
+
+    // frame 6 from the flange and q7
+    const Eigen::Matrix3d &r7 = flange.linear();
+    Eigen::Vector3d p7 = flange.translation() - d_flange * r7.col(2);
+    Eigen::Matrix3d r6;
+    r6.col(0) = r7 * Eigen::Vector3d(std::cos(q7), -std::sin(q7), 0);
+    r6.col(2) = r7 * Eigen::Vector3d(std::sin(q7), std::cos(q7), 0);
+    r6.col(1) = r6.col(2).cross(r6.col(0));
+    Eigen::Vector3d p6 = p7 - a7 * r6.col(0);
+
+    // q4 from |p6 - p2|: a c4 + b s4 = k
+    Eigen::Vector3d p2(0, 0, d1);
+    double l26_sq = (p6 - p2).squaredNorm();
+    double a = d3 * d5 - a4 * a4;
+    double b = -a4 * (d3 + d5);
+    double k = (l26_sq - (a4 * a4 + d3 * d3) - (a4 * a4 + d5 * d5)) / 2;
+    double r = std::sqrt(a * a + b * b);
+    if (std::fabs(k) > r)
+        return 0;
+    double phi = std::atan2(b, a);
+    double spread = std::acos(k / r);
+
+    for (double q4 : {phi + spread, phi - spread})
+    {
+        if (!wrapInto(q4, limits.lower[3], limits.upper[3]))
+            continue;
+        double c4 = std::cos(q4), s4 = std::sin(q4);
+
+        // shoulder to frame 6 in frame 4, it has no z component
+        double ux = -a4 + a4 * c4 + d3 * s4;
+        double uy = d5 - a4 * s4 + d3 * c4;
+        if (std::fabs(ux) < eps)
+            continue;
+
+        // the same vector in frame 6: (c6 c5 ux + s6 uy, -s6 c5 ux + c6 uy, s5 ux)
+        Eigen::Vector3d m = r6.transpose() * (p6 - p2);
+        double s5 = m.z() / ux;
+        if (std::fabs(s5) > 1 + eps)
+            continue;
+        s5 = std::max(-1.0, std::min(1.0, s5));
+        double c5_abs = std::sqrt(1 - s5 * s5);
+
+        for (double c5 : {c5_abs, -c5_abs})
+        {
+            double q5 = std::atan2(s5, c5);
+            double q6 = std::atan2(uy, c5 * ux) - std::atan2(m.y(), m.x());
+            if (!wrapInto(q5, limits.lower[4], limits.upper[4]) || !wrapInto(q6, limits.lower[5], limits.upper[5]))
+                continue;
+
+            // the shoulder rotation is Rz(q1) Ry(q2) Rz(q3)
+            Eigen::Isometry3d t36 = dh(a4, 0, M_PI_2, q4) * dh(-a4, d5, -M_PI_2, q5) * dh(0, 0, M_PI_2, q6);
+            Eigen::Matrix3d r03 = r6 * t36.linear().transpose();
+
+            double c2 = std::max(-1.0, std::min(1.0, r03(2, 2)));
+            double s2_abs = std::sqrt(1 - c2 * c2);
+            if (s2_abs < 1e-7)
+            {
+                // q1 and q3 turn about the same axis
+                Joints q = {{q1_singular, 0, std::atan2(r03(1, 0), r03(0, 0)) - q1_singular, q4, q5, q6, q7}};
+                if (wrapInto(q[0], limits.lower[0], limits.upper[0]) && wrapInto(q[2], limits.lower[2], limits.upper[2]) &&
+                    limits.contains(q))
+                {
+                    solutions.push_back(q);
+                    found++;
+                }
+                continue;
+            }
+
+            for (double s2 : {s2_abs, -s2_abs})
+            {
+                Joints q;
+                q[0] = std::atan2(r03(1, 2) / s2, r03(0, 2) / s2);
+                q[1] = std::atan2(s2, c2);
+                q[2] = std::atan2(r03(2, 1) / s2, -r03(2, 0) / s2);
+                q[3] = q4;
+                q[4] = q5;
+                q[5] = q6;
+                q[6] = q7;
+                if (wrapInto(q[0], limits.lower[0], limits.upper[0]) && wrapInto(q[2], limits.lower[2], limits.upper[2]) &&
+                    limits.contains(q))
+                {
+                    solutions.push_back(q);
+                    found++;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+inline double distance(const Joints &a, const Joints &b)
+{
+    double sum = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+        sum += (a[i] - b[i]) * (a[i] - b[i]);
+    return sum;
+}
+
+// Sweeps q7 outwards from the seed's q7 in steps of `step` and returns the
+// solution closest to the seed at the first q7 that has any. Stops after
+// max_steps in each direction; 0 sweeps the whole range of q7.
+inline bool solveNearest(const Eigen::Isometry3d &flange, const Joints &seed, const Limits &limits, double step, Joints &solution,
+                         size_t max_steps = 0)
+{
+    std::vector<Joints> candidates;
+    double range = limits.upper[6] - limits.lower[6];
+    size_t steps = static_cast<size_t>(std::ceil(range / step));
+    if (max_steps > 0 && max_steps < steps)
+        steps = max_steps;
+
+    double q7 = std::max(limits.lower[6], std::min(limits.upper[6], seed[6]));
+    for (size_t i = 0; i <= steps; ++i)
+    {
+        candidates.clear();
+        solve(flange, q7 + i * step, limits, candidates, seed[0]);
+        if (i > 0)
+            solve(flange, q7 - i * step, limits, candidates, seed[0]);
+        if (candidates.empty())
+            continue;
+
+        double best = distance(candidates.front(), seed);
+        solution = candidates.front();
+        for (const Joints &candidate : candidates)
+        {
+            double d = distance(candidate, seed);
+            if (d < best)
+            {
+                best = d;
+                solution = candidate;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+} // namespace panda_ik
@@ -0,0 +1,334 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "paper_benchmarks/panda_analytic_ik.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Forward kinematics of a single Panda arm for many configurations at once.
+// Joint values come in a structure-of-arrays layout and each SIMD lane
+// evaluates one configuration. The chain is written out step by step with
+// the DH parameters of panda_analytic_ik.hpp as compile-time constants, so
+// the twists of +-90 degrees are column swaps rather than multiplications
+// and the zero offsets drop out. Sine and cosine are evaluated with a
+// vectorized polynomial accurate to a few float ulps over the joint range.
+// Frames are computed in float and in the link0 frame; the error against
+// RobotState stays below 1e-5 m (see fk_benchmark).
+namespace panda_fk
+{
+
+// joint values of n configurations, q[j][i] is joint j of configuration i
+struct JointsSoA
+{
+    std::array<std::vector<float>, 7> q;
+
+    size_t size() const
+    {
+        return q[0].size();
+    }
+
+    void resize(size_t n)
+    {
+        for (auto &joint : q)
+            joint.resize(n, 0.f);
+    }
+
+    void set(size_t i, const double *joint_values)
+    {
+        if (i >= size())
+            resize(i + 1);
+        for (size_t j = 0; j < 7; ++j)
+            q[j][i] = static_cast<float>(joint_values[j]);
+    }
+
+    void get(size_t i, double *joint_values) const
+    {
+        for (size_t j = 0; j < 7; ++j)
+            joint_values[j] = q[j][i];
+    }
+};
+
+// rigid transforms of n configurations; r holds the rotation column by
+// column (r[0..2] is the x axis) and p the origin
+struct FramesSoA
+{
+    std::array<std::vector<float>, 9> r;
+    std::array<std::vector<float>, 3> p;
+
+    size_t size() const
+    {
+        return p[0].size();
+    }
+
+    void resize(size_t n)
+    {
+        for (auto &v : r)
+            v.resize(n, 0.f);
+        for (auto &v : p)
+            v.resize(n, 0.f);
+    }
+};
+
+// link1 .. link7 and the flange (link8)
+const size_t link_count = 8;
+
+namespace simd
+{
+
+#if defined(__AVX2__)
+
+typedef __m256 Vec;
+const size_t width = 8;
+
+inline Vec load(const float *p) { return _mm256_loadu_ps(p); }
+inline void store(float *p, Vec v) { _mm256_storeu_ps(p, v); }
+inline Vec set1(float v) { return _mm256_set1_ps(v); }
+inline Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+inline Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+inline Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+inline Vec neg(Vec a) { return _mm256_sub_ps(_mm256_setzero_ps(), a); }
+
+inline void sincos(Vec x, Vec &s, Vec &c)
+{
+    // quadrant j = round(x / (pi/2)), remainder in [-pi/4, pi/4]
+    __m256i j = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(0.636619772f)));
+    __m256 jf = _mm256_cvtepi32_ps(j);
+    __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(jf, _mm256_set1_ps(1.5703125f)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(jf, _mm256_set1_ps(4.837512969970703125e-4f)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(jf, _mm256_set1_ps(7.549789948768648e-8f)));
+    __m256 r2 = _mm256_mul_ps(r, r);
+
+    __m256 ps = _mm256_add_ps(_mm256_mul_ps(r2, _mm256_set1_ps(-1.9515295891e-4f)), _mm256_set1_ps(8.3321608736e-3f));
+    ps = _mm256_add_ps(_mm256_mul_ps(ps, r2), _mm256_set1_ps(-1.6666654611e-1f));
+    ps = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(ps, r2), r), r);
+
+    __m256 pc = _mm256_add_ps(_mm256_mul_ps(r2, _mm256_set1_ps(2.443315711809948e-5f)), _mm256_set1_ps(-1.388731625493765e-3f));
+    pc = _mm256_add_ps(_mm256_mul_ps(pc, r2), _mm256_set1_ps(4.166664568298827e-2f));
+    pc = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(pc, r2), r2), _mm256_sub_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(r2, _mm256_set1_ps(0.5f))));
+
+    // odd quadrants swap sine and cosine, the sign bits follow from j
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, one), one));
+    __m256 sin_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, two), 30));
+    __m256 cos_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(j, one), two), 30));
+    s = _mm256_xor_ps(_mm256_blendv_ps(ps, pc, swap), sin_sign);
+    c = _mm256_xor_ps(_mm256_blendv_ps(pc, ps, swap), cos_sign);
+}
+
+#elif defined(__SSE2__)
+
+typedef __m128 Vec;
+const size_t width = 4;
+
+inline Vec load(const float *p) { return _mm_loadu_ps(p); }
+inline void store(float *p, Vec v) { _mm_storeu_ps(p, v); }
+inline Vec set1(float v) { return _mm_set1_ps(v); }
+inline Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+inline Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+inline Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+inline Vec neg(Vec a) { return _mm_sub_ps(_mm_setzero_ps(), a); }
+
+inline void sincos(Vec x, Vec &s, Vec &c)
+{
+    __m128i j = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.636619772f)));
+    __m128 jf = _mm_cvtepi32_ps(j);
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(jf, _mm_set1_ps(1.5703125f)));
+    r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(4.837512969970703125e-4f)));
+    r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(7.549789948768648e-8f)));
+    __m128 r2 = _mm_mul_ps(r, r);
+
+    __m128 ps = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(-1.9515295891e-4f)), _mm_set1_ps(8.3321608736e-3f));
+    ps = _mm_add_ps(_mm_mul_ps(ps, r2), _mm_set1_ps(-1.6666654611e-1f));
+    ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, r2), r), r);
+
+    __m128 pc = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(2.443315711809948e-5f)), _mm_set1_ps(-1.388731625493765e-3f));
+    pc = _mm_add_ps(_mm_mul_ps(pc, r2), _mm_set1_ps(4.166664568298827e-2f));
+    pc = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(pc, r2), r2), _mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(r2, _mm_set1_ps(0.5f))));
+
+    // SSE2 has no blendv, select with and/andnot/or
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, one), one));
+    __m128 sin_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, two), 30));
+    __m128 cos_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, one), two), 30));
+    s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps)), sin_sign);
+    c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc)), cos_sign);
+}
+
+#else
+
+typedef float Vec;
+const size_t width = 1;
+
+inline Vec load(const float *p) { return *p; }
+inline void store(float *p, Vec v) { *p = v; }
+inline Vec set1(float v) { return v; }
+inline Vec add(Vec a, Vec b) { return a + b; }
+inline Vec sub(Vec a, Vec b) { return a - b; }
+inline Vec mul(Vec a, Vec b) { return a * b; }
+inline Vec neg(Vec a) { return -a; }
+
+inline void sincos(Vec x, Vec &s, Vec &c)
+{
+    s = std::sin(x);
+    c = std::cos(x);
+}
+
+#endif
+
+} // namespace simd
+
+namespace detail
+{
+
+using simd::Vec;
+
+struct Frame
+{
+    Vec r[9];
+    Vec p[3];
+};
+
+// appends RotX(alpha) TransX(a) RotZ(theta) TransZ(d) to f, where alpha is
+// Twist * 90 degrees
+template <int Twist>
+inline void step(Frame &f, float a, float d, Vec c, Vec s)
+{
+    Vec *x = f.r, *y = f.r + 3, *z = f.r + 6;
+    for (int k = 0; k < 3; ++k)
+    {
+        if (a != 0)
+            f.p[k] = simd::add(f.p[k], simd::mul(simd::set1(a), x[k]));
+
+        // the twist about x: +90 maps (y, z) to (z, -y), -90 to (-z, y)
+        Vec ty = Twist == 0 ? y[k] : Twist > 0 ? z[k] : simd::neg(z[k]);
+        Vec tz = Twist == 0 ? z[k] : Twist > 0 ? simd::neg(y[k]) : y[k];
+
+        Vec nx = simd::add(simd::mul(c, x[k]), simd::mul(s, ty));
+        y[k] = simd::sub(simd::mul(c, ty), simd::mul(s, x[k]));
+        x[k] = nx;
+        z[k] = tz;
+
+        if (d != 0)
+            f.p[k] = simd::add(f.p[k], simd::mul(simd::set1(d), tz));
+    }
+}
+
+inline void emit(const Frame &f, FramesSoA &out, size_t i)
+{
+    for (int k = 0; k < 9; ++k)
+        simd::store(out.r[k].data() + i, f.r[k]);
+    for (int k = 0; k < 3; ++k)
+        simd::store(out.p[k].data() + i, f.p[k]);
+}
+
+// FK of width configurations starting at q[.][0]; with AllLinks every link
+// frame is stored to links[0..7], otherwise only the flange to links[0]
+template <bool AllLinks>
+inline void kernel(const float *const q[7], FramesSoA *links, size_t i)
+{
+    Vec c[7], s[7];
+    for (int j = 0; j < 7; ++j)
+        simd::sincos(simd::load(q[j]), s[j], c[j]);
+
+    // link1 is a rotation about the base z axis, d1 above link0
+    const Vec zero = simd::set1(0.f), one = simd::set1(1.f);
+    Frame f;
+    f.r[0] = c[0], f.r[1] = s[0], f.r[2] = zero;
+    f.r[3] = simd::neg(s[0]), f.r[4] = c[0], f.r[5] = zero;
+    f.r[6] = zero, f.r[7] = zero, f.r[8] = one;
+    f.p[0] = zero, f.p[1] = zero, f.p[2] = simd::set1(static_cast<float>(panda_ik::d1));
+    if (AllLinks)
+        emit(f, links[0], i);
+
+    step<-1>(f, 0.f, 0.f, c[1], s[1]);
+    if (AllLinks)
+        emit(f, links[1], i);
+    step<1>(f, 0.f, static_cast<float>(panda_ik::d3), c[2], s[2]);
+    if (AllLinks)
+        emit(f, links[2], i);
+    step<1>(f, static_cast<float>(panda_ik::a4), 0.f, c[3], s[3]);
+    if (AllLinks)
+        emit(f, links[3], i);
+    step<-1>(f, static_cast<float>(-panda_ik::a4), static_cast<float>(panda_ik::d5), c[4], s[4]);
+    if (AllLinks)
+        emit(f, links[4], i);
+    step<1>(f, 0.f, 0.f, c[5], s[5]);
+    if (AllLinks)
+        emit(f, links[5], i);
+    step<1>(f, static_cast<float>(panda_ik::a7), 0.f, c[6], s[6]);
+    if (AllLinks)
+        emit(f, links[6], i);
+
+    // the flange sits d_flange along the z axis of link7
+    const Vec d = simd::set1(static_cast<float>(panda_ik::d_flange));
+    for (int k = 0; k < 3; ++k)
+        f.p[k] = simd::add(f.p[k], simd::mul(d, f.r[6 + k]));
+    emit(f, links[AllLinks ? 7 : 0], i);
+}
+
+// runs the kernel over all configurations; the tail that does not fill a
+// vector goes through a zero padded copy
+template <bool AllLinks>
+inline void run(const JointsSoA &joints, FramesSoA *links, size_t link_outputs)
+{
+    const size_t n = joints.size();
+    for (size_t l = 0; l < link_outputs; ++l)
+        links[l].resize(n);
+
+    const float *q[7];
+    size_t i = 0;
+    for (; i + simd::width <= n; i += simd::width)
+    {
+        for (int j = 0; j < 7; ++j)
+            q[j] = joints.q[j].data() + i;
+        kernel<AllLinks>(q, links, i);
+    }
+    if (i == n)
+        return;
+
+    float padded[7][simd::width] = {};
+    for (int j = 0; j < 7; ++j)
+    {
+        for (size_t k = 0; i + k < n; ++k)
+            padded[j][k] = joints.q[j][i + k];
+        q[j] = padded[j];
+    }
+
+    FramesSoA tail[link_count];
+    for (size_t l = 0; l < link_outputs; ++l)
+        tail[l].resize(simd::width);
+    kernel<AllLinks>(q, tail, 0);
+    for (size_t l = 0; l < link_outputs; ++l)
+    {
+        for (int k = 0; k < 9; ++k)
+            std::copy(tail[l].r[k].begin(), tail[l].r[k].begin() + (n - i), links[l].r[k].begin() + i);
+        for (int k = 0; k < 3; ++k)
+            std::copy(tail[l].p[k].begin(), tail[l].p[k].begin() + (n - i), links[l].p[k].begin() + i);
+    }
+}
+
+} // namespace detail
+
+// flange poses of all configurations in the link0 frame
+inline void flangePoses(const JointsSoA &joints, FramesSoA &flange)
+{
+    detail::run<false>(joints, &flange, 1);
+}
+
+// frames of link1 .. link7 and the flange of all configurations
+inline void linkFrames(const JointsSoA &joints, std::array<FramesSoA, link_count> &links)
+{
+    detail::run<true>(joints, links.data(), link_count);
+}
+
+} // namespace panda_fk
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <rclcpp/rclcpp.hpp>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/robot_state.h>
+#include <geometry_msgs/msg/pose.hpp>
+#include <Eigen/Dense>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "paper_benchmarks/arm_executor.hpp"
+
+// IK front-end that runs several restarts of the group's solver at once and
+// picks among the solutions instead of taking the first one. One restart is
+// seeded with the reference configuration (usually where the arm is), the
+// others start from random configurations. Everything found before the
+// deadline is compared, and the solution closest to the reference in joint
+// space or the one with the best manipulability wins.
+//
+// Kinematics plugins are not guaranteed to be thread safe, so every worker
+// loads its own robot model and with it its own solver instance.
+class ParallelIk
+{
+public:
+    enum Selection
+    {
+        CLOSEST,
+        MANIPULABILITY
+    };
+
+    struct Stats
+    {
+        size_t solves = 0;
+        size_t solved = 0;
+        size_t solutions = 0;
+    };
+
+private:
+    struct Worker
+    {
+        std::shared_ptr<robot_model_loader::RobotModelLoader> loader;
+        std::unique_ptr<moveit::core::RobotState> state;
+        const moveit::core::JointModelGroup *jmg;
+        ArmExecutor executor;
+    };
+
+    struct Candidate
+    {
+        bool found = false;
+        std::vector<double> joint_values;
+        double manipulability = 0;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    double deadline;
+    Selection selection;
+    std::mutex mutex;
+    Stats stats;
+
+    static double manipulability(moveit::core::RobotState &state, const moveit::core::JointModelGroup *jmg)
+    {
+        Eigen::MatrixXd jacobian = state.getJacobian(jmg);
+        double det = (jacobian * jacobian.transpose()).determinant();
+        return det > 0 ? std::sqrt(det) : 0;
+    }
+
+    // squared joint-space distance; infinity if the sizes differ, so such a
+    // candidate never ranks above one that can be compared
+    static double distance(const std::vector<double> &a, const std::vector<double> &b)
+    {
+        if (a.size() != b.size())
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+        double sum = 0;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            sum += (a[i] - b[i]) * (a[i] - b[i]);
+        }
+        return sum;
+    }
+
+public:
+    ParallelIk(const rclcpp::Node::SharedPtr &node, const std::string &group, size_t seeds = 4, double deadline_seconds = 0.05,
+               Selection select = CLOSEST)
+        : deadline(deadline_seconds), selection(select)
+    {
+        for (size_t i = 0; i < std::max<size_t>(1, seeds); ++i)
+        {
+            std::unique_ptr<Worker> worker(new Worker);
+            worker->loader = std::make_shared<robot_model_loader::RobotModelLoader>(node, "robot_description");
+            worker->state.reset(new moveit::core::RobotState(worker->loader->getModel()));
+            worker->state->setToDefaultValues();
+            worker->jmg = worker->loader->getModel()->getJointModelGroup(group);
+            workers.push_back(std::move(worker));
+        }
+    }
+
+    void setSelection(Selection select)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        selection = select;
+    }
+
+    // Solves for `pose`, judging solutions against `reference`. Returns
+    // false if no restart found a solution before the deadline.
+    bool solve(const geometry_msgs::msg::Pose &pose, const std::vector<double> &reference, std::vector<double> &joint_values)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto start = std::chrono::steady_clock::now();
+        auto until = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(deadline));
+        bool score_manipulability = selection == MANIPULABILITY;
+
+        std::vector<std::future<Candidate>> results;
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            Worker *worker = workers[i].get();
+            bool seeded = i == 0 && !reference.empty();
+            double timeout = deadline;
+            results.push_back(worker->executor.submit([worker, seeded, reference, pose, timeout, score_manipulability]()
+                                                      {
+                Candidate candidate;
+                if (seeded)
+                    worker->state->setJointGroupPositions(worker->jmg, reference);
+                else
+                    worker->state->setToRandomPositions(worker->jmg);
+
+                candidate.found = worker->state->setFromIK(worker->jmg, pose, timeout);
+                if (candidate.found)
+                {
+                    worker->state->copyJointGroupPositions(worker->jmg, candidate.joint_values);
+                    if (score_manipulability)
+                        candidate.manipulability = manipulability(*worker->state, worker->jmg);
+                }
+                return candidate; }));
+        }
+
+        // a restart that overruns keeps running on its worker and its
+        // result is dropped; the solver timeout bounds how long that takes
+        bool found = false;
+        double best = std::numeric_limits<double>::infinity();
+        size_t solutions = 0;
+        for (auto &result : results)
+        {
+            if (result.wait_until(until + std::chrono::milliseconds(5)) != std::future_status::ready)
+            {
+                continue;
+            }
+            Candidate candidate = result.get();
+            if (!candidate.found)
+            {
+                continue;
+            }
+            solutions++;
+            double cost = score_manipulability ? -candidate.manipulability : distance(candidate.joint_values, reference);
+            // without a reference every distance is infinite, take the first
+            if (!found || cost < best)
+            {
+                best = cost;
+                joint_values = candidate.joint_values;
+                found = true;
+            }
+        }
+
+        stats.solves++;
+        stats.solutions += solutions;
+        if (found)
+        {
+            stats.solved++;
+        }
+        return found;
+    }
+
+    Stats statistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+};
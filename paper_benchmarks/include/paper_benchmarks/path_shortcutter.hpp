@@ -0,0 +1,358 @@
+#pragma once
+
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/robot_state/robot_state.h>
+#include <moveit/robot_state/conversions.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/trajectory_processing/time_optimal_trajectory_generation.h>
+#include <moveit_msgs/msg/robot_state.hpp>
+#include <moveit_msgs/msg/robot_trajectory.hpp>
+#include <rclcpp/duration.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+// Shortens a joint space path after planning. Randomized shortcutting picks
+// two waypoints and replaces the path between them by a straight line if
+// that line is collision free; a batch of such attempts is checked in
+// parallel per round and the valid one that saves the most length is
+// applied. The corners left over are then rounded with a clamped uniform
+// cubic B-spline through the waypoints as control points, which is only
+// kept if the whole curve is collision free as well.
+//
+// The state check is called from several threads at once and has to be
+// safe for that.
+class PathShortcutter
+{
+public:
+    typedef std::vector<double> Joints;
+    typedef std::function<bool(const Joints &)> StateCheck;
+
+private:
+    StateCheck valid;
+    double resolution;
+    int rounds;
+    int batch;
+    int samples_per_segment;
+    std::mt19937 random;
+
+    static double distance(const Joints &a, const Joints &b)
+    {
+        double sum = 0;
+        for (size_t j = 0; j < a.size(); ++j)
+        {
+            sum += (a[j] - b[j]) * (a[j] - b[j]);
+        }
+        return std::sqrt(sum);
+    }
+
+    // the states strictly between a and b, at most `resolution` apart in
+    // every joint, are valid
+    bool segmentValid(const Joints &a, const Joints &b) const
+    {
+        double largest = 0;
+        for (size_t j = 0; j < a.size(); ++j)
+        {
+            largest = std::max(largest, std::fabs(b[j] - a[j]));
+        }
+        int steps = static_cast<int>(std::ceil(largest / resolution));
+
+        Joints q(a.size());
+        for (int s = 1; s < steps; ++s)
+        {
+            double t = static_cast<double>(s) / steps;
+            for (size_t j = 0; j < a.size(); ++j)
+            {
+                q[j] = a[j] + t * (b[j] - a[j]);
+            }
+            if (!valid(q))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // every waypoint after the first and every segment of `path`, split
+    // over `batch` threads
+    bool pathValid(const std::vector<Joints> &path) const
+    {
+        size_t segments = path.size() - 1;
+        size_t chunk = (segments + batch - 1) / batch;
+        std::vector<std::future<bool>> checks;
+        for (size_t first = 0; first < segments; first += chunk)
+        {
+            size_t last = std::min(segments, first + chunk);
+            checks.push_back(std::async(std::launch::async, [this, &path, first, last]()
+                                        {
+                for (size_t i = first; i < last; ++i)
+                {
+                    if (!valid(path[i + 1]) || !segmentValid(path[i], path[i + 1]))
+                        return false;
+                }
+                return true; }));
+        }
+
+        bool result = true;
+        for (auto &check : checks)
+        {
+            result = check.get() && result;
+        }
+        return result;
+    }
+
+    static Joints bspline(const Joints &c0, const Joints &c1, const Joints &c2, const Joints &c3, double t)
+    {
+        double b0 = (1 - t) * (1 - t) * (1 - t) / 6;
+        double b1 = (3 * t * t * t - 6 * t * t + 4) / 6;
+        double b2 = (-3 * t * t * t + 3 * t * t + 3 * t + 1) / 6;
+        double b3 = t * t * t / 6;
+
+        Joints q(c0.size());
+        for (size_t j = 0; j < q.size(); ++j)
+        {
+            q[j] = b0 * c0[j] + b1 * c1[j] + b2 * c2[j] + b3 * c3[j];
+        }
+        return q;
+    }
+
+public:
+    PathShortcutter(StateCheck check, double step = 0.05, int shortcut_rounds = 25, int attempts_per_round = 4,
+                    int spline_samples = 8, unsigned seed = 1)
+        : valid(check), resolution(step), rounds(shortcut_rounds), batch(std::max(1, attempts_per_round)),
+          samples_per_segment(std::max(1, spline_samples)), random(seed)
+    {
+    }
+
+    static double length(const std::vector<Joints> &path)
+    {
+        double sum = 0;
+        for (size_t i = 1; i < path.size(); ++i)
+        {
+            sum += distance(path[i - 1], path[i]);
+        }
+        return sum;
+    }
+
+    // Returns the number of shortcuts applied. The end points stay.
+    int shortcut(std::vector<Joints> &path)
+    {
+        int applied = 0;
+        for (int round = 0; round < rounds && path.size() > 2; ++round)
+        {
+            // pairs at least two waypoints apart, so there is something to cut
+            std::uniform_int_distribution<size_t> pick(0, path.size() - 1);
+            std::vector<std::pair<size_t, size_t>> pairs;
+            for (int b = 0; b < batch; ++b)
+            {
+                size_t i = pick(random), j = pick(random);
+                if (i > j)
+                    std::swap(i, j);
+                if (j >= i + 2)
+                    pairs.emplace_back(i, j);
+            }
+
+            std::vector<std::future<bool>> checks;
+            for (const auto &pair : pairs)
+            {
+                const Joints &a = path[pair.first];
+                const Joints &b = path[pair.second];
+                checks.push_back(std::async(std::launch::async, [this, &a, &b]()
+                                            { return segmentValid(a, b); }));
+            }
+
+            double best_gain = 1e-6;
+            int best = -1;
+            for (size_t p = 0; p < pairs.size(); ++p)
+            {
+                if (!checks[p].get())
+                    continue;
+
+                double along = 0;
+                for (size_t k = pairs[p].first; k < pairs[p].second; ++k)
+                {
+                    along += distance(path[k], path[k + 1]);
+                }
+                double gain = along - distance(path[pairs[p].first], path[pairs[p].second]);
+                if (gain > best_gain)
+                {
+                    best_gain = gain;
+                    best = static_cast<int>(p);
+                }
+            }
+
+            if (best >= 0)
+            {
+                path.erase(path.begin() + pairs[best].first + 1, path.begin() + pairs[best].second);
+                applied++;
+            }
+        }
+        return applied;
+    }
+
+    // Replaces the path by samples of its B-spline if those are valid. The
+    // end points are repeated three times, so the curve starts and ends on
+    // them.
+    bool smooth(std::vector<Joints> &path) const
+    {
+        if (path.size() < 3)
+        {
+            return false;
+        }
+
+        std::vector<Joints> control;
+        control.push_back(path.front());
+        control.push_back(path.front());
+        control.insert(control.end(), path.begin(), path.end());
+        control.push_back(path.back());
+        control.push_back(path.back());
+
+        std::vector<Joints> curve;
+        for (size_t k = 0; k + 3 < control.size(); ++k)
+        {
+            for (int s = 0; s < samples_per_segment; ++s)
+            {
+                curve.push_back(bspline(control[k], control[k + 1], control[k + 2], control[k + 3],
+                                        static_cast<double>(s) / samples_per_segment));
+            }
+        }
+        curve.push_back(path.back());
+
+        if (!pathValid(curve))
+        {
+            return false;
+        }
+        path = curve;
+        return true;
+    }
+};
+
+// PathShortcutter on planned trajectories of one group. The waypoints of
+// the trajectory are shortcut and smoothed, and the result is timed again
+// with time-optimal trajectory generation at the given scaling. The state
+// check comes from a factory called once per trajectory, so it can work on
+// a snapshot of the planning scene taken right then.
+class TrajectoryShortcutter
+{
+public:
+    typedef std::function<PathShortcutter::StateCheck()> CheckFactory;
+
+    struct Stats
+    {
+        size_t processed = 0;
+        size_t shortcuts = 0;
+        size_t smoothed = 0;
+        double length_before = 0;
+        double length_after = 0;
+        double duration_before = 0;
+        double duration_after = 0;
+        double processing_time = 0;
+    };
+
+private:
+    moveit::core::RobotModelConstPtr model;
+    const moveit::core::JointModelGroup *jmg;
+    double velocity_scaling;
+    double acceleration_scaling;
+    CheckFactory factory;
+    unsigned seed = 1;
+    std::mutex mutex;
+    Stats stats;
+
+    static double duration(const moveit_msgs::msg::RobotTrajectory &trajectory)
+    {
+        const auto &points = trajectory.joint_trajectory.points;
+        return points.empty() ? 0 : rclcpp::Duration(points.back().time_from_start).seconds();
+    }
+
+public:
+    TrajectoryShortcutter(const moveit::core::RobotModelConstPtr &robot_model, const std::string &group_name,
+                          double max_velocity_scaling = 1.0, double max_acceleration_scaling = 1.0)
+        : model(robot_model), jmg(robot_model->getJointModelGroup(group_name)), velocity_scaling(max_velocity_scaling),
+          acceleration_scaling(max_acceleration_scaling)
+    {
+    }
+
+    void setCheckFactory(CheckFactory f)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        factory = f;
+    }
+
+    // Shortens `trajectory`, which starts at `start`. Returns false and
+    // leaves it as it is if nothing could be shortened.
+    bool process(const moveit_msgs::msg::RobotState &start, moveit_msgs::msg::RobotTrajectory &trajectory)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        CheckFactory make_check;
+        unsigned run_seed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            make_check = factory;
+            run_seed = seed++;
+        }
+        if (!make_check || trajectory.joint_trajectory.points.size() < 3)
+        {
+            return false;
+        }
+
+        moveit::core::RobotState state(model);
+        moveit::core::robotStateMsgToRobotState(start, state);
+        robot_trajectory::RobotTrajectory path(model, jmg->getName());
+        path.setRobotTrajectoryMsg(state, trajectory);
+
+        std::vector<PathShortcutter::Joints> waypoints(path.getWayPointCount());
+        for (size_t i = 0; i < waypoints.size(); ++i)
+        {
+            path.getWayPoint(i).copyJointGroupPositions(jmg, waypoints[i]);
+        }
+        double length_before = PathShortcutter::length(waypoints);
+
+        PathShortcutter shortcutter(make_check(), 0.05, 25, 4, 8, run_seed);
+        int shortcuts = shortcutter.shortcut(waypoints);
+        bool smoothed = shortcutter.smooth(waypoints);
+        if (shortcuts == 0 && !smoothed)
+        {
+            return false;
+        }
+
+        robot_trajectory::RobotTrajectory shortened(model, jmg->getName());
+        for (const auto &q : waypoints)
+        {
+            state.setJointGroupPositions(jmg, q);
+            shortened.addSuffixWayPoint(state, 0.0);
+        }
+        trajectory_processing::TimeOptimalTrajectoryGeneration totg(0.001, 0.02);
+        if (!totg.computeTimeStamps(shortened, velocity_scaling, acceleration_scaling))
+        {
+            return false;
+        }
+
+        moveit_msgs::msg::RobotTrajectory result;
+        shortened.getRobotTrajectoryMsg(result);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.processed++;
+        stats.shortcuts += shortcuts;
+        stats.smoothed += smoothed ? 1 : 0;
+        stats.length_before += length_before;
+        stats.length_after += PathShortcutter::length(waypoints);
+        stats.duration_before += duration(trajectory);
+        stats.duration_after += duration(result);
+        stats.processing_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        trajectory = result;
+        return true;
+    }
+
+    Stats statistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+};
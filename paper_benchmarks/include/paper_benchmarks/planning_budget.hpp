@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Planning time and attempts per request, learned from how long earlier
+// requests of the same kind took. Requests are grouped by a key such as
+// "panda_1/move". Until a key has `min_samples` successful plans it gets
+// the default budget. After that the time is the `quantile` of the recent
+// successful solve times times `margin`. Keys that almost always succeed
+// get fewer attempts. Every failure in a row doubles the time and adds an
+// attempt, up to the maximum, so a hard stage is not given up too early.
+class PlanningBudget
+{
+public:
+    struct Budget
+    {
+        double time;
+        int attempts;
+    };
+
+    struct Options
+    {
+        double default_time = 1.0;
+        int default_attempts = 5;
+        double min_time = 0.1;
+        double max_time = 5.0;
+        int min_attempts = 2;
+        int max_attempts = 10;
+        double quantile = 0.95;
+        double margin = 1.5;
+        // rate above which a key counts as easy
+        double easy_rate = 0.95;
+        size_t min_samples = 5;
+        size_t window = 50;
+    };
+
+private:
+    struct History
+    {
+        std::deque<double> solve_times;
+        std::deque<bool> outcomes;
+        int failure_streak = 0;
+        size_t requests = 0;
+        double time_spent = 0;
+    };
+
+    Options options;
+    std::mutex mutex;
+    std::map<std::string, History> histories;
+
+    double quantileOf(const std::deque<double> &times) const
+    {
+        std::vector<double> sorted(times.begin(), times.end());
+        size_t k = std::min(sorted.size() - 1, static_cast<size_t>(std::ceil(options.quantile * sorted.size())) - 1);
+        std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+        return sorted[k];
+    }
+
+    static double successRate(const History &history)
+    {
+        if (history.outcomes.empty())
+            return 0;
+        return static_cast<double>(std::count(history.outcomes.begin(), history.outcomes.end(), true)) / history.outcomes.size();
+    }
+
+    Budget budgetOf(const History &history) const
+    {
+        Budget budget{options.default_time, options.default_attempts};
+        if (history.solve_times.size() >= options.min_samples)
+        {
+            budget.time = std::min(options.max_time, std::max(options.min_time, quantileOf(history.solve_times) * options.margin));
+            if (successRate(history) >= options.easy_rate)
+                budget.attempts = options.min_attempts;
+        }
+
+        // back off after failures in a row
+        budget.time = std::min(options.max_time, budget.time * std::pow(2.0, history.failure_streak));
+        budget.attempts = std::min(options.max_attempts, budget.attempts + history.failure_streak);
+        return budget;
+    }
+
+public:
+    PlanningBudget() {}
+    explicit PlanningBudget(const Options &o) : options(o) {}
+
+    Budget budget(const std::string &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return budgetOf(histories[key]);
+    }
+
+    // one planning request of `key` that took `seconds`
+    void record(const std::string &key, double seconds, bool success)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        History &history = histories[key];
+        history.requests++;
+        history.time_spent += seconds;
+
+        history.outcomes.push_back(success);
+        if (history.outcomes.size() > options.window)
+            history.outcomes.pop_front();
+
+        if (!success)
+        {
+            history.failure_streak++;
+            return;
+        }
+        history.failure_streak = 0;
+        history.solve_times.push_back(seconds);
+        if (history.solve_times.size() > options.window)
+            history.solve_times.pop_front();
+    }
+
+    // one line per key, for the log
+    std::vector<std::string> summary()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::string> lines;
+        for (const auto &entry : histories)
+        {
+            Budget budget = budgetOf(entry.second);
+            std::ostringstream out;
+            out << entry.first << ": " << entry.second.requests << " requests, " << entry.second.time_spent << " s planning, "
+                << successRate(entry.second) * 100 << "% recent success, budget " << budget.time << " s x " << budget.attempts;
+            lines.push_back(out.str());
+        }
+        return lines;
+    }
+};
@@ -5,6 +5,9 @@
 #include <moveit/move_group_interface/move_group_interface.h>
 #include <geometry_msgs/msg/pose.hpp>
 #include "paper_benchmarks/scene.hpp"
+#include "paper_benchmarks/reachability_map.hpp"
+#include "paper_benchmarks/ik_service.hpp"
+#include "paper_benchmarks/cartesian_fast_path.hpp"
 #include <moveit/planning_scene_interface/planning_scene_interface.h>
 
 struct tray_helper
@@ -72,6 +75,48 @@ struct tray_helper
     }
 };
 
+// Top-down gripper pose `height` above a cube, as used for the pregrasp and
+// grasp stages of the benchmarks.
+inline geometry_msgs::msg::Pose approach_pose(const moveit_msgs::msg::CollisionObject &object, double height)
+{
+    geometry_msgs::msg::Pose pose;
+    pose.position.x = object.pose.position.x;
+    pose.position.y = object.pose.position.y;
+    pose.position.z = object.pose.position.z + height;
+
+    pose.orientation.x = object.pose.orientation.w;
+    pose.orientation.y = object.pose.orientation.z;
+    pose.orientation.z = 0;
+    pose.orientation.w = 0;
+    return pose;
+}
+
+// Loads panda_1.reach and panda_2.reach written by build_reachability_map
+// into a cube queue, so it never hands an arm a cube the arm cannot reach.
+// Does nothing for an empty directory.
+template <typename Queue>
+void load_reachability_maps(Queue &queue, const std::string &directory, const rclcpp::Logger &logger)
+{
+    if (directory.empty())
+        return;
+
+    const std::pair<const char *, const char *> arms[] = {{"robot_1", "panda_1"}, {"robot_2", "panda_2"}};
+    for (const auto &arm : arms)
+    {
+        auto map = std::make_shared<ReachabilityMap>();
+        std::string path = directory + "/" + arm.second + ".reach";
+        if (map->load(path))
+        {
+            queue.setReachability(arm.first, map);
+            RCLCPP_INFO(logger, "Loaded reachability map %s", path.c_str());
+        }
+        else
+        {
+            RCLCPP_ERROR(logger, "Could not load reachability map %s", path.c_str());
+        }
+    }
+}
+
 class primitive_pick_and_place
 {
 public:
@@ -91,8 +136,11 @@ public:
     std::map<std::string, moveit_msgs::msg::ObjectColor> getCollisionObjectColors();
     bool home();
     void set_default();
+    std::shared_ptr<IkService> ik_solver();
 
 private:
+    void reached(bool success);
+
     std::shared_ptr<moveit::planning_interface::PlanningSceneInterface> planning_interface;
     std::shared_ptr<moveit::core::RobotState> current_state;
     std::string move_group;
@@ -103,7 +151,14 @@ private:
     std::vector<double> joint_values;
     std::shared_ptr<moveit::planning_interface::MoveGroupInterface> move_group_interface;
     std::shared_ptr<moveit::planning_interface::MoveGroupInterface> gripper_group_interface;
+    std::shared_ptr<IkService> ik_service;
     moveit::planning_interface::MoveGroupInterface::Plan plan;
+    // the pose of the pending target and of the last one reached, for the
+    // straight-line fast path of generate_plan()
+    geometry_msgs::msg::Pose target_pose;
+    geometry_msgs::msg::Pose reached_pose;
+    bool has_target_pose = false;
+    bool has_reached_pose = false;
     double timeout_duration;
     bool has_gripper = false;
     int counter = 0;
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+// Per-arm reachability map over a voxel grid of cube positions, produced by
+// build_reachability_map. Each voxel holds a score in 0..255: 0 means no
+// grasp of a cube centred in the voxel was found, otherwise the score grows
+// with the share of grasp yaws that have an IK solution and with the arm's
+// manipulability at the grasp pose.
+//
+// File layout (little endian): "PBRM", uint32 version, float origin[3],
+// float resolution, uint32 nx, ny, nz, then nx * ny * nz uint8 scores with
+// z varying fastest.
+class ReachabilityMap
+{
+private:
+    enum : uint32_t
+    {
+        format_version = 1
+    };
+
+    float origin[3] = {0, 0, 0};
+    float resolution = 1;
+    uint32_t dims[3] = {0, 0, 0};
+    std::vector<uint8_t> scores;
+
+public:
+    ReachabilityMap() {}
+
+    ReachabilityMap(const float min_corner[3], float voxel_size, const uint32_t size[3]) : resolution(voxel_size)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            origin[a] = min_corner[a];
+            dims[a] = size[a];
+        }
+        scores.assign(static_cast<size_t>(dims[0]) * dims[1] * dims[2], 0);
+    }
+
+    size_t voxelCount() const
+    {
+        return scores.size();
+    }
+
+    size_t index(uint32_t ix, uint32_t iy, uint32_t iz) const
+    {
+        return (static_cast<size_t>(ix) * dims[1] + iy) * dims[2] + iz;
+    }
+
+    // centre of the voxel with the given linear index
+    void centre(size_t i, float &x, float &y, float &z) const
+    {
+        uint32_t iz = i % dims[2];
+        uint32_t iy = (i / dims[2]) % dims[1];
+        uint32_t ix = static_cast<uint32_t>(i / (static_cast<size_t>(dims[2]) * dims[1]));
+        x = origin[0] + (ix + 0.5f) * resolution;
+        y = origin[1] + (iy + 0.5f) * resolution;
+        z = origin[2] + (iz + 0.5f) * resolution;
+    }
+
+    void set(size_t i, uint8_t score)
+    {
+        scores[i] = score;
+    }
+
+    // score of the voxel containing (x, y, z); 0 outside the grid
+    uint8_t score(float x, float y, float z) const
+    {
+        float p[3] = {x, y, z};
+        uint32_t cell[3];
+        for (int a = 0; a < 3; ++a)
+        {
+            float f = std::floor((p[a] - origin[a]) / resolution);
+            if (!(f >= 0) || f >= static_cast<float>(dims[a]))
+            {
+                return 0;
+            }
+            cell[a] = static_cast<uint32_t>(f);
+        }
+        return scores[index(cell[0], cell[1], cell[2])];
+    }
+
+    bool reachable(float x, float y, float z) const
+    {
+        return score(x, y, z) > 0;
+    }
+
+    bool save(const std::string &path) const
+    {
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+        {
+            return false;
+        }
+        uint32_t file_version = format_version;
+        out.write("PBRM", 4);
+        out.write(reinterpret_cast<const char *>(&file_version), sizeof(file_version));
+        out.write(reinterpret_cast<const char *>(origin), sizeof(origin));
+        out.write(reinterpret_cast<const char *>(&resolution), sizeof(resolution));
+        out.write(reinterpret_cast<const char *>(dims), sizeof(dims));
+        out.write(reinterpret_cast<const char *>(scores.data()), scores.size());
+        return static_cast<bool>(out);
+    }
+
+    bool load(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        char magic[4];
+        uint32_t file_version = 0;
+        if (!in.read(magic, 4) || std::memcmp(magic, "PBRM", 4) != 0 ||
+            !in.read(reinterpret_cast<char *>(&file_version), sizeof(file_version)) || file_version != format_version)
+        {
+            return false;
+        }
+        in.read(reinterpret_cast<char *>(origin), sizeof(origin));
+        in.read(reinterpret_cast<char *>(&resolution), sizeof(resolution));
+        in.read(reinterpret_cast<char *>(dims), sizeof(dims));
+        if (!in || !(resolution > 0))
+        {
+            return false;
+        }
+        scores.resize(static_cast<size_t>(dims[0]) * dims[1] * dims[2]);
+        in.read(reinterpret_cast<char *>(scores.data()), scores.size());
+        return static_cast<bool>(in);
+    }
+};
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/robot_state/robot_state.h>
+#include <moveit_msgs/msg/robot_trajectory.hpp>
+#include <rclcpp/duration.hpp>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Space-time reservations of the arms' motions. Each arm plans against the
+// scene as it is when planning, with the other arm wherever it is at that
+// moment, so a plan can run into the other arm once both move. A trajectory
+// about to be executed is entered here with the links it sweeps in every
+// time slice; before it is entered it is checked against the trajectories
+// of the other arms at the same instants. The swept links are the arm's,
+// those of its end effector (hand and fingers) and the bodies attached to
+// them, i.e. the cube in the gripper, which are what meet in the middle of
+// the table. The check is coarse first, one box per slice around the whole
+// arm and then one per link, and exact only where the boxes overlap. If the trajectory conflicts it is shifted by
+// whole slices until it fits, and the caller waits that long before
+// starting it instead of colliding or being aborted.
+//
+// Before its start an arm counts as standing at its first waypoint, after
+// its end at its last. Once the motion is over the arm keeps a hold where it
+// stopped, so a stationary arm is still seen by the other's reservations,
+// until its next motion is reserved. A motion that finds no conflict free
+// start within the maximum delay is not entered at all; the caller plans it
+// again instead of running into the other arm.
+class ReservationTable
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    // true if the two arms collide in the given joint configurations
+    typedef std::function<bool(const std::vector<std::string> &, const std::vector<double> &, const std::vector<std::string> &,
+                               const std::vector<double> &)>
+        ExactCheck;
+
+    // a body attached to a link, e.g. the cube in the gripper, bounded by a
+    // sphere given in the frame of that link
+    struct AttachedSphere
+    {
+        std::string link;
+        Eigen::Vector3d center;
+        double radius;
+    };
+    typedef std::function<std::vector<AttachedSphere>()> AttachedBodies;
+
+    struct Stats
+    {
+        size_t reservations = 0;
+        size_t delayed = 0;
+        size_t unresolved = 0;
+        size_t exact_checks = 0;
+        double delay = 0;
+    };
+
+private:
+    struct Box
+    {
+        Eigen::Vector3d min = Eigen::Vector3d::Constant(std::numeric_limits<double>::infinity());
+        Eigen::Vector3d max = Eigen::Vector3d::Constant(-std::numeric_limits<double>::infinity());
+
+        void add(const Eigen::Vector3d &center, double radius)
+        {
+            min = min.cwiseMin(center - Eigen::Vector3d::Constant(radius));
+            max = max.cwiseMax(center + Eigen::Vector3d::Constant(radius));
+        }
+
+        void add(const Box &other)
+        {
+            min = min.cwiseMin(other.min);
+            max = max.cwiseMax(other.max);
+        }
+
+        bool overlaps(const Box &other, double padding) const
+        {
+            return (min.array() - padding <= other.max.array()).all() && (other.min.array() - padding <= max.array()).all();
+        }
+    };
+
+    struct Reservation
+    {
+        Clock::time_point start;
+        double duration = 0;
+        trajectory_msgs::msg::JointTrajectory joints;
+        std::vector<double> times;
+        // per slice: one box per link, and one around all of them
+        std::vector<std::vector<Box>> link_boxes;
+        std::vector<Box> arm_boxes;
+    };
+
+    moveit::core::RobotModelConstPtr model;
+    moveit::core::RobotState state;
+    double slice;
+    double padding;
+    double max_delay;
+    ExactCheck exact;
+    AttachedBodies attached;
+    std::mutex mutex;
+    std::map<std::string, Reservation> reservations;
+    Stats stats;
+
+    static double seconds(const builtin_interfaces::msg::Duration &d)
+    {
+        return rclcpp::Duration(d).seconds();
+    }
+
+    // joint values at `t` seconds into the trajectory, held at the ends
+    static std::vector<double> at(const Reservation &r, double t)
+    {
+        const auto &points = r.joints.points;
+        if (t <= r.times.front())
+            return points.front().positions;
+        if (t >= r.times.back())
+            return points.back().positions;
+
+        size_t i = std::upper_bound(r.times.begin(), r.times.end(), t) - r.times.begin();
+        double s = (t - r.times[i - 1]) / std::max(1e-9, r.times[i] - r.times[i - 1]);
+        std::vector<double> q(points[i].positions.size());
+        for (size_t j = 0; j < q.size(); ++j)
+        {
+            q[j] = points[i - 1].positions[j] + s * (points[i].positions[j] - points[i - 1].positions[j]);
+        }
+        return q;
+    }
+
+    // samples the trajectory a few times per slice and bounds every link of
+    // the arm and its end effector, and every body attached to one of them,
+    // by the sphere around its collision geometry
+    Reservation sweep(const std::string &group, const moveit_msgs::msg::RobotTrajectory &trajectory)
+    {
+        Reservation r;
+        r.joints = trajectory.joint_trajectory;
+        for (const auto &point : r.joints.points)
+        {
+            r.times.push_back(seconds(point.time_from_start));
+        }
+        r.duration = r.times.back();
+
+        const moveit::core::JointModelGroup *jmg = model->getJointModelGroup(group);
+        std::vector<const moveit::core::LinkModel *> swept = jmg->getLinkModels();
+        for (const std::string &name : jmg->getAttachedEndEffectorNames())
+        {
+            const moveit::core::JointModelGroup *eef = model->getEndEffector(name);
+            swept.insert(swept.end(), eef->getLinkModels().begin(), eef->getLinkModels().end());
+        }
+
+        // the links as spheres in their own frames, with the attached bodies
+        std::vector<const moveit::core::LinkModel *> links;
+        std::vector<Eigen::Vector3d> centers;
+        std::vector<double> radii;
+        for (const auto *link : swept)
+        {
+            if (!link->getShapes().empty() && std::find(links.begin(), links.end(), link) == links.end())
+            {
+                links.push_back(link);
+                centers.push_back(link->getCenteredBoundingBoxOffset());
+                radii.push_back(link->getShapeExtentsAtOrigin().norm() / 2);
+            }
+        }
+        if (attached)
+        {
+            for (const AttachedSphere &body : attached())
+            {
+                auto link = std::find_if(swept.begin(), swept.end(), [&body](const moveit::core::LinkModel *l)
+                                         { return l->getName() == body.link; });
+                if (link != swept.end())
+                {
+                    links.push_back(*link);
+                    centers.push_back(body.center);
+                    radii.push_back(body.radius);
+                }
+            }
+        }
+
+        size_t slices = static_cast<size_t>(std::floor(r.duration / slice)) + 1;
+        r.link_boxes.assign(slices, std::vector<Box>(links.size()));
+        r.arm_boxes.assign(slices, Box());
+
+        const int samples = 4;
+        for (size_t k = 0; k < slices; ++k)
+        {
+            for (int s = 0; s <= samples; ++s)
+            {
+                double t = std::min(r.duration, (k + static_cast<double>(s) / samples) * slice);
+                state.setVariablePositions(r.joints.joint_names, at(r, t));
+                state.update();
+                for (size_t l = 0; l < links.size(); ++l)
+                {
+                    r.link_boxes[k][l].add(state.getGlobalLinkTransform(links[l]) * centers[l], radii[l]);
+                }
+            }
+            for (const Box &box : r.link_boxes[k])
+            {
+                r.arm_boxes[k].add(box);
+            }
+        }
+        return r;
+    }
+
+    size_t sliceOf(const Reservation &r, double t) const
+    {
+        if (t <= 0)
+            return 0;
+        return std::min(r.arm_boxes.size() - 1, static_cast<size_t>(std::floor(t / slice)));
+    }
+
+    // true if `mine`, starting at mine.start, runs into `theirs`; checked
+    // until both have ended
+    bool conflicts(const Reservation &mine, const Reservation &theirs)
+    {
+        double offset = std::chrono::duration<double>(mine.start - theirs.start).count();
+        size_t count = std::max(mine.arm_boxes.size(), static_cast<size_t>(std::ceil(std::max(0.0, theirs.duration - offset) / slice)));
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t m = std::min(i, mine.arm_boxes.size() - 1);
+            double from = offset + i * slice, to = offset + (i + 1) * slice;
+            for (size_t j = sliceOf(theirs, from); j <= sliceOf(theirs, to); ++j)
+            {
+                if (!mine.arm_boxes[m].overlaps(theirs.arm_boxes[j], padding))
+                    continue;
+
+                bool links_overlap = false;
+                for (const Box &a : mine.link_boxes[m])
+                {
+                    for (const Box &b : theirs.link_boxes[j])
+                    {
+                        links_overlap = links_overlap || a.overlaps(b, padding);
+                    }
+                }
+                if (!links_overlap)
+                    continue;
+                if (!exact)
+                    return true;
+
+                // the two arms at the same instants within the slice
+                for (int s = 0; s <= 4; ++s)
+                {
+                    double t = (i + s / 4.0) * slice;
+                    stats.exact_checks++;
+                    if (exact(mine.joints.joint_names, at(mine, t), theirs.joints.joint_names, at(theirs, offset + t)))
+                        return true;
+                }
+            }
+        }
+        return false;
+    }
+
+public:
+    ReservationTable(const moveit::core::RobotModelConstPtr &robot_model, double slice_seconds = 0.1, double padding_meters = 0.05,
+                     double max_delay_seconds = 5.0)
+        : model(robot_model), state(robot_model), slice(slice_seconds), padding(padding_meters), max_delay(max_delay_seconds)
+    {
+        state.setToDefaultValues();
+    }
+
+    void setExactCheck(ExactCheck check)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        exact = check;
+    }
+
+    // the bodies attached to the arms now; without it only the robot's own
+    // links are swept
+    void setAttachedBodies(AttachedBodies bodies)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        attached = bodies;
+    }
+
+    // Enters `trajectory` of `group` at the earliest start, in whole slices
+    // from now, at which it does not run into the other arms, and returns
+    // how long to wait in `delay`. If no start within the maximum delay
+    // works nothing is entered, the arm's hold stays, and false is returned.
+    bool reserve(const std::string &group, const moveit_msgs::msg::RobotTrajectory &trajectory, double &delay)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        delay = 0;
+        if (trajectory.joint_trajectory.points.empty())
+        {
+            return true;
+        }
+
+        Reservation mine = sweep(group, trajectory);
+        Clock::time_point now = Clock::now();
+        bool found = false;
+        for (double d = 0; d <= max_delay + 1e-9 && !found; d += slice)
+        {
+            mine.start = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(d));
+            found = true;
+            for (const auto &other : reservations)
+            {
+                if (other.first != group && conflicts(mine, other.second))
+                {
+                    found = false;
+                    break;
+                }
+            }
+            if (found)
+                delay = d;
+        }
+
+        stats.reservations++;
+        if (!found)
+        {
+            delay = 0;
+            stats.unresolved++;
+            return false;
+        }
+        if (delay > 0)
+        {
+            stats.delayed++;
+            stats.delay += delay;
+        }
+        reservations[group] = mine;
+        return true;
+    }
+
+    // The arm stopped at `positions`, e.g. at the end of its motion or
+    // wherever an aborted one left it. It stays reserved there from now on
+    // until its next reservation.
+    void hold(const std::string &group, const std::vector<std::string> &names, const std::vector<double> &positions)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        moveit_msgs::msg::RobotTrajectory standing;
+        standing.joint_trajectory.joint_names = names;
+        standing.joint_trajectory.points.resize(1);
+        standing.joint_trajectory.points[0].positions = positions;
+
+        Reservation r = sweep(group, standing);
+        r.start = Clock::now();
+        reservations[group] = r;
+    }
+
+    Stats statistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+};
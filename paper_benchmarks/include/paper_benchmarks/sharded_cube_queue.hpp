@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <limits>
+#include "paper_benchmarks/cube_selector.hpp"
+
+// One ThreadSafeCubeQueue per arm. A cube is pushed to the shard whose anchor
+// (the arm base) is closest in the table plane, so with the two Pandas at
+// y = -0.5 and y = 0.5 the cubes split by the side of the table. An arm pops
+// from its own shard, which only it consumes, and steals from the fullest
+// other shard once its own runs dry. Each shard keeps its own lock, so the
+// arms never contend with each other outside of a steal.
+class ShardedCubeQueue
+{
+private:
+    std::vector<Point3D> anchors;
+    std::vector<std::unique_ptr<ThreadSafeCubeQueue>> shards;
+
+public:
+    explicit ShardedCubeQueue(const std::vector<Point3D> &arm_anchors) : anchors(arm_anchors)
+    {
+        for (const Point3D &anchor : anchors)
+        {
+            shards.emplace_back(new ThreadSafeCubeQueue(anchor));
+        }
+    }
+
+    size_t shardCount() const
+    {
+        return shards.size();
+    }
+
+    size_t shardOf(const CollisionObject &cube) const
+    {
+        size_t best = 0;
+        float best_distance = std::numeric_limits<float>::max();
+        for (size_t i = 0; i < anchors.size(); ++i)
+        {
+            float dx = cube.pose.position.x - anchors[i].x;
+            float dy = cube.pose.position.y - anchors[i].y;
+            float distance = dx * dx + dy * dy;
+            if (distance < best_distance)
+            {
+                best_distance = distance;
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    void setReachability(const std::string &robot_planning, std::shared_ptr<const ReachabilityMap> map)
+    {
+        for (auto &shard : shards)
+        {
+            shard->setReachability(robot_planning, map);
+        }
+    }
+
+    // all shards share the same maps
+    bool reachable(const std::string &robot_planning, const CollisionObject &cube) const
+    {
+        return shards.empty() || shards.front()->reachable(robot_planning, cube);
+    }
+
+    void push(CollisionPlanningObject &cube)
+    {
+        shards[shardOf(cube.collisionObject)]->push(cube);
+    }
+
+    bool empty() const
+    {
+        for (const auto &shard : shards)
+        {
+            if (!shard->empty())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t size() const
+    {
+        size_t total = 0;
+        for (const auto &shard : shards)
+        {
+            total += shard->size();
+        }
+        return total;
+    }
+
+    size_t size(size_t shard) const
+    {
+        return shards[shard]->size();
+    }
+
+    std::vector<CubeCandidate> peekNearest(const Point3D &p, size_t k, const std::string &robot_planning)
+    {
+        std::vector<CubeCandidate> candidates;
+        for (size_t i = 0; i < shards.size(); ++i)
+        {
+            for (CubeCandidate &candidate : shards[i]->peekNearest(p, k, robot_planning))
+            {
+                candidate.shard = i;
+                candidates.push_back(std::move(candidate));
+            }
+        }
+        return candidates;
+    }
+
+    bool claim(const CubeCandidate &candidate, const std::string &robot_planning, CollisionPlanningObject &cube)
+    {
+        return shards[candidate.shard]->claim(candidate, robot_planning, cube);
+    }
+
+    // Pops the cube for the arm owning `shard`, searching around p (the arm's
+    // end effector). Falls back to the fullest other shard when the own shard
+    // is empty. Returns an object with an empty id if every shard is empty.
+    CollisionPlanningObject pop(size_t shard, std::string robot_planning, std::string s, const Point3D &p)
+    {
+        CollisionPlanningObject cube = shards[shard]->pop(robot_planning, s, p);
+        if (!cube.collisionObject.id.empty())
+        {
+            return cube;
+        }
+
+        // work stealing: try the other shards from the fullest one down
+        std::vector<bool> tried(shards.size(), false);
+        tried[shard] = true;
+        while (true)
+        {
+            size_t victim = shards.size();
+            size_t victim_size = 0;
+            for (size_t i = 0; i < shards.size(); ++i)
+            {
+                size_t n = tried[i] ? 0 : shards[i]->size();
+                if (n > victim_size)
+                {
+                    victim_size = n;
+                    victim = i;
+                }
+            }
+            if (victim == shards.size())
+            {
+                return cube;
+            }
+
+            tried[victim] = true;
+            cube = shards[victim]->pop(robot_planning, s, p);
+            if (!cube.collisionObject.id.empty())
+            {
+                return cube;
+            }
+        }
+    }
+};
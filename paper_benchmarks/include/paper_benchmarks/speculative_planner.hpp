@@ -0,0 +1,210 @@
+#pragma once
+
+#include <rclcpp/rclcpp.hpp>
+#include <moveit/move_group_interface/move_group_interface.h>
+#include <moveit/robot_state/robot_state.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "paper_benchmarks/arm_executor.hpp"
+
+// A planning pipeline and planner of the move group, e.g. pilz PTP or OMPL
+// RRTConnect. Listing a randomized planner more than once races several
+// differently seeded runs of it.
+struct PlannerVariant
+{
+    std::string pipeline;
+    std::string planner;
+
+    PlannerVariant() {}
+    PlannerVariant(const std::string &p, const std::string &id) : pipeline(p), planner(id) {}
+};
+
+// Sends the same joint goal to several planners at once and takes the first
+// valid plan, or the shortest one that arrives within `grace` seconds after
+// it. A single planner that stalls then no longer holds up the stage, which
+// is what hurts the asynchronous schedule most.
+//
+// Every variant plans through its own MoveGroupInterface on its own worker,
+// since one interface holds one request. A plan request cannot be cancelled
+// through the interface, so the losers are abandoned: they finish on the
+// move group and their result is dropped. A variant whose worker is still
+// busy with an abandoned request sits the next race out instead of queueing
+// behind it.
+class SpeculativePlanner
+{
+public:
+    typedef moveit::planning_interface::MoveGroupInterface MoveGroupInterface;
+
+    struct Stats
+    {
+        size_t races = 0;
+        size_t failed = 0;
+        size_t skipped = 0;
+        double latency = 0;
+        std::vector<size_t> wins;
+    };
+
+private:
+    struct Worker
+    {
+        PlannerVariant variant;
+        std::shared_ptr<MoveGroupInterface> group;
+        std::atomic<bool> busy{false};
+        ArmExecutor executor;
+    };
+
+    // results of one race, shared with the workers, which may outlive it
+    struct Race
+    {
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t finished = 0;
+        std::vector<std::pair<size_t, MoveGroupInterface::Plan>> plans;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    double grace;
+    std::mutex mutex;
+    Stats stats;
+
+    static double duration(const MoveGroupInterface::Plan &plan)
+    {
+        const auto &points = plan.trajectory_.joint_trajectory.points;
+        return points.empty() ? 0 : rclcpp::Duration(points.back().time_from_start).seconds();
+    }
+
+public:
+    SpeculativePlanner(const rclcpp::Node::SharedPtr &node, const std::string &group, const std::vector<PlannerVariant> &variants,
+                       double grace_seconds = 0.05, double velocity_scaling = 1.0, double acceleration_scaling = 1.0,
+                       double planning_time = 1.0)
+        : grace(grace_seconds)
+    {
+        for (const auto &variant : variants)
+        {
+            std::unique_ptr<Worker> worker(new Worker);
+            worker->variant = variant;
+            worker->group = std::make_shared<MoveGroupInterface>(node, group);
+            worker->group->setPlanningPipelineId(variant.pipeline);
+            worker->group->setPlannerId(variant.planner);
+            worker->group->setMaxVelocityScalingFactor(velocity_scaling);
+            worker->group->setMaxAccelerationScalingFactor(acceleration_scaling);
+            worker->group->setNumPlanningAttempts(1);
+            worker->group->setPlanningTime(planning_time);
+            workers.push_back(std::move(worker));
+        }
+        stats.wins.assign(workers.size(), 0);
+    }
+
+    // Plans from `start` to the joint goal, giving every variant
+    // `planning_time` seconds if that is positive. False if every variant
+    // that took part failed.
+    bool plan(const moveit::core::RobotState &start, const std::vector<std::string> &names, const std::vector<double> &goal,
+              MoveGroupInterface::Plan &result, double planning_time = 0)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        auto race = std::make_shared<Race>();
+
+        auto launch = [&](size_t i)
+        {
+            Worker *worker = workers[i].get();
+            worker->executor.submit([worker, race, i, start, names, goal, planning_time]()
+                                    {
+                MoveGroupInterface::Plan plan;
+                if (planning_time > 0)
+                    worker->group->setPlanningTime(planning_time);
+                worker->group->setStartState(start);
+                worker->group->setJointValueTarget(names, goal);
+                bool success = worker->group->plan(plan) == moveit::core::MoveItErrorCode::SUCCESS &&
+                               !plan.trajectory_.joint_trajectory.points.empty();
+                worker->busy = false;
+
+                std::lock_guard<std::mutex> lock(race->mutex);
+                race->finished++;
+                if (success)
+                    race->plans.emplace_back(i, plan);
+                race->done.notify_all(); });
+        };
+
+        size_t started = 0, skipped = 0;
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            if (workers[i]->busy.exchange(true))
+            {
+                skipped++;
+                continue;
+            }
+            launch(i);
+            started++;
+        }
+        // all still busy, wait in line behind the first one
+        if (started == 0 && !workers.empty())
+        {
+            launch(0);
+            started++;
+        }
+
+        std::unique_lock<std::mutex> lock(race->mutex);
+        race->done.wait(lock, [&]()
+                        { return !race->plans.empty() || race->finished == started; });
+        if (!race->plans.empty())
+        {
+            auto until = std::chrono::steady_clock::now() +
+                         std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(grace));
+            race->done.wait_until(lock, until, [&]()
+                                  { return race->finished == started; });
+        }
+
+        bool found = false;
+        size_t winner = 0;
+        double best = std::numeric_limits<double>::infinity();
+        for (const auto &candidate : race->plans)
+        {
+            double d = duration(candidate.second);
+            if (d < best)
+            {
+                best = d;
+                winner = candidate.first;
+                result = candidate.second;
+                found = true;
+            }
+        }
+        lock.unlock();
+
+        std::lock_guard<std::mutex> stats_lock(mutex);
+        stats.races++;
+        stats.skipped += skipped;
+        stats.latency += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        if (found)
+            stats.wins[winner]++;
+        else
+            stats.failed++;
+        return found;
+    }
+
+    Stats statistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    // races, failures and wins per variant, for the log
+    std::string summary()
+    {
+        Stats s = statistics();
+        std::ostringstream out;
+        out << s.races << " races, " << s.failed << " failed, " << s.skipped << " variants skipped while busy, "
+            << (s.races ? s.latency / s.races : 0.0) << " s mean latency, wins:";
+        for (size_t i = 0; i < workers.size(); ++i)
+        {
+            out << " " << workers[i]->variant.pipeline << "/" << workers[i]->variant.planner << " " << s.wins[i];
+        }
+        return out.str();
+    }
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <rclcpp/rclcpp.hpp>
+#include <moveit/move_group_interface/move_group_interface.h>
+#include <moveit/robot_model/joint_model_group.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include "paper_benchmarks/reservation_table.hpp"
+#include "paper_benchmarks/trajectory_retimer.hpp"
+
+// The execution half of a StagePipeline as a chain of small stages like
+// the planners in stage_planner.hpp, outermost first:
+//
+//   RetimedExecution -> ReservedExecution -> MoveGroupExecution
+//
+// The chain runs on the pipeline's motion thread, so everything at its end
+// uses the arm's execution interface, never the one it plans with.
+
+// A motion to execute. `stage` names the stage it belongs to; `timed`
+// marks motions whose timing is final, e.g. blended ones.
+struct StageMotion
+{
+    std::string stage;
+    moveit::planning_interface::MoveGroupInterface::Plan plan;
+    bool timed = false;
+};
+
+class StageExecution
+{
+public:
+    virtual ~StageExecution() {}
+
+    // blocks until the motion has finished; false if it failed or was
+    // never started
+    virtual bool execute(StageMotion &motion) = 0;
+};
+
+typedef std::shared_ptr<StageExecution> StageExecutionPtr;
+
+class MoveGroupExecution : public StageExecution
+{
+private:
+    moveit::planning_interface::MoveGroupInterface &execution;
+
+public:
+    explicit MoveGroupExecution(moveit::planning_interface::MoveGroupInterface &execution_group) : execution(execution_group)
+    {
+    }
+
+    bool execute(StageMotion &motion) override
+    {
+        return execution.execute(motion.plan) == moveit::core::MoveItErrorCode::SUCCESS;
+    }
+};
+
+// Times every motion again with the scaling of its stage before it is
+// sent, see TrajectoryRetimer.
+class RetimedExecution : public StageExecution
+{
+private:
+    StageExecutionPtr next;
+    std::shared_ptr<TrajectoryRetimer> retimer;
+
+public:
+    RetimedExecution(StageExecutionPtr execution, std::shared_ptr<TrajectoryRetimer> trajectory_retimer)
+        : next(execution), retimer(trajectory_retimer)
+    {
+    }
+
+    bool execute(StageMotion &motion) override
+    {
+        if (!motion.timed)
+        {
+            retimer->retime(motion.stage, motion.plan.start_state_, motion.plan.trajectory_);
+        }
+        return next->execute(motion);
+    }
+};
+
+// Waits until the motion no longer runs into the other arm's before it
+// starts, see ReservationTable. Without a conflict free start within the
+// table's maximum delay the motion counts as failed, so the stage is
+// planned again from where the arm is, around the other arm as it is then.
+// Afterwards the arm's resting place stays reserved until its next motion.
+class ReservedExecution : public StageExecution
+{
+private:
+    StageExecutionPtr next;
+    std::shared_ptr<ReservationTable> reservations;
+    const moveit::core::JointModelGroup *jmg;
+    moveit::planning_interface::MoveGroupInterface &execution;
+    rclcpp::Logger logger;
+
+public:
+    ReservedExecution(StageExecutionPtr inner, std::shared_ptr<ReservationTable> table, const moveit::core::JointModelGroup *group,
+                      moveit::planning_interface::MoveGroupInterface &execution_group, const rclcpp::Logger &log)
+        : next(inner), reservations(table), jmg(group), execution(execution_group), logger(log)
+    {
+    }
+
+    bool execute(StageMotion &motion) override
+    {
+        double delay = 0;
+        if (!reservations->reserve(jmg->getName(), motion.plan.trajectory_, delay))
+        {
+            RCLCPP_INFO(logger, "No conflict free start within the maximum delay, not starting");
+            return false;
+        }
+        if (delay > 0)
+        {
+            RCLCPP_INFO(logger, "Delaying the start by %.2f s for the other arm", delay);
+            std::this_thread::sleep_for(std::chrono::duration<double>(delay));
+        }
+        bool success = next->execute(motion);
+        reservations->hold(jmg->getName(), jmg->getVariableNames(), execution.getCurrentJointValues());
+        return success;
+    }
+};
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <rclcpp/rclcpp.hpp>
+#include <moveit/move_group_interface/move_group_interface.h>
+#include <moveit/robot_state/robot_state.h>
+#include <geometry_msgs/msg/pose.hpp>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "paper_benchmarks/arm_executor.hpp"
+#include "paper_benchmarks/stage_execution.hpp"
+#include "paper_benchmarks/stage_planner.hpp"
+#include "paper_benchmarks/trajectory_blender.hpp"
+
+// How often a stage may fail before the whole pick and place is given up.
+// 0 means retry until it works, which is what the stages after the grasp
+// need since the cube is in the gripper by then.
+struct StageRetryPolicy
+{
+    int ik_attempts = 0;
+    int plan_attempts = 0;
+
+    StageRetryPolicy() {}
+    StageRetryPolicy(int ik, int plan) : ik_attempts(ik), plan_attempts(plan) {}
+};
+
+// One motion of a pick and place: where the tip link goes, how often to
+// retry and what to do to the scene before moving (attach or detach the
+// cube). The target is generated when the stage is planned, so it may
+// depend on state that changes between cubes, e.g. the tray slot. Stages
+// with a goal id have their trajectories cached under it.
+struct PipelineStage
+{
+    std::string name;
+    std::function<geometry_msgs::msg::Pose()> target;
+    StageRetryPolicy retry;
+    std::function<void()> before;
+    std::function<std::string()> goal;
+    SymmetricTarget symmetric;
+
+    PipelineStage(const std::string &n, std::function<geometry_msgs::msg::Pose()> t, StageRetryPolicy r = StageRetryPolicy(),
+                  std::function<void()> b = nullptr, std::function<std::string()> g = nullptr)
+        : name(n), target(t), retry(r), before(b), goal(g)
+    {
+    }
+
+    // the target is the chosen candidate, the first one until a choice is made
+    PipelineStage(const std::string &n, SymmetricTarget s, StageRetryPolicy r = StageRetryPolicy(),
+                  std::function<void()> b = nullptr, std::function<std::string()> g = nullptr)
+        : name(n), retry(r), before(b), goal(g), symmetric(s)
+    {
+        target = [s]()
+        { return s.candidates()[std::max(0, *s.choice)]; };
+    }
+};
+
+
+// Runs a list of stages on one arm. While stage N executes, stage N + 1 is
+// planned from the goal state of stage N, so planning time hides behind the
+// motion instead of adding to it. A stage with a `before` hook changes the
+// planning scene first and is therefore planned only once the previous
+// stage has finished. A plan made ahead is dropped if the motion before it
+// fails; the stage is then planned again from the actual state.
+//
+// Plans come from `planner` on the caller's thread and are executed by
+// `execution` on the motion thread, see stage_planner.hpp and
+// stage_execution.hpp for the stages of both chains. A MoveGroupInterface
+// is not safe to use from two threads, so the two chains must end in
+// different interfaces of the same group; `current` is only read for the
+// state the arm is in, on the caller's thread.
+//
+// With a blender the stages between two `before` hooks are planned first,
+// one after the other from the previous goal, and then joined into a single
+// trajectory that is executed without stopping in between. The hooks stay
+// synchronisation points: the arm stops there, the hook runs (the gripper
+// closes or opens) and the next group is planned in the changed scene.
+class StagePipeline
+{
+private:
+    typedef moveit::planning_interface::MoveGroupInterface MoveGroupInterface;
+
+    MoveGroupInterface &current;
+    const moveit::core::JointModelGroup *jmg;
+    StagePlannerPtr planner;
+    StageExecutionPtr execution;
+    std::shared_ptr<TrajectoryBlender> blender;
+    rclcpp::Logger logger;
+    bool plan_ahead;
+    // execute() blocks, so it runs here while the caller plans ahead
+    ArmExecutor motion;
+    // target of the stage planned last, where the next stage starts; a
+    // vertical move from there is planned as a straight line
+    geometry_msgs::msg::Pose last_target;
+    bool has_last_target = false;
+    // IK seed of the next stage, where the stage before it ends
+    std::vector<double> seed;
+
+    // after a failed motion the next plan starts where the arm actually is
+    void resetToCurrentState()
+    {
+        has_last_target = false;
+        current.getCurrentState()->copyJointGroupPositions(jmg, seed);
+    }
+
+    // plans a single attempt, from `start` or from the current state if
+    // start is null; `goal` is `start` with this arm where the plan ends
+    bool planOnce(const PipelineStage &stage, const moveit::core::RobotState *start, int ik_attempts,
+                  MoveGroupInterface::Plan &plan, moveit::core::RobotStatePtr &goal)
+    {
+        StageRequest request;
+        request.stage = stage.name;
+        request.group = jmg;
+        request.start = start ? std::make_shared<moveit::core::RobotState>(*start) : current.getCurrentState();
+        request.from_current = !start;
+        request.target = stage.target();
+        request.symmetric = stage.symmetric;
+        request.ik_attempts = ik_attempts;
+        request.goal_id = stage.goal ? stage.goal() : "";
+        request.previous_target = last_target;
+        request.has_previous_target = has_last_target;
+        request.seed = seed;
+
+        if (!planner->plan(request, plan) || plan.trajectory_.joint_trajectory.points.empty())
+        {
+            return false;
+        }
+        last_target = request.target;
+        has_last_target = !request.cached;
+
+        // the other arm stays where it is in the start; this one may end on
+        // another IK branch than the goal it was planned to, e.g. after a
+        // straight line
+        const auto &trajectory = plan.trajectory_.joint_trajectory;
+        goal = std::make_shared<moveit::core::RobotState>(*request.start);
+        goal->setVariablePositions(trajectory.joint_names, trajectory.points.back().positions);
+        goal->update();
+        goal->copyJointGroupPositions(jmg, seed);
+        return true;
+    }
+
+    // plans from `start` or the current state, honouring the stage's retry
+    // policy
+    bool plan(const PipelineStage &stage, const moveit::core::RobotState *start, MoveGroupInterface::Plan &plan,
+              moveit::core::RobotStatePtr &goal)
+    {
+        int failures = 0;
+        while (!planOnce(stage, start, stage.retry.ik_attempts, plan, goal))
+        {
+            if (stage.retry.plan_attempts > 0 && ++failures >= stage.retry.plan_attempts)
+            {
+                RCLCPP_INFO(logger, "%s: planning did not succeed", stage.name.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool execute(const std::string &stage, const MoveGroupInterface::Plan &plan, bool timed = false)
+    {
+        StageMotion m;
+        m.stage = stage;
+        m.plan = plan;
+        m.timed = timed;
+        return execution->execute(m);
+    }
+
+    // plans stages [first, last) back to back, the first from the current
+    // state; `goal` is where the last one ends
+    bool planGroup(const std::vector<PipelineStage> &stages, size_t first, size_t last,
+                   std::vector<MoveGroupInterface::Plan> &plans, moveit::core::RobotStatePtr &goal)
+    {
+        plans.assign(last - first, MoveGroupInterface::Plan());
+        for (size_t i = first; i < last; ++i)
+        {
+            moveit::core::RobotStatePtr start = goal;
+            if (!plan(stages[i], i == first ? nullptr : start.get(), plans[i - first], goal))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // executes a planned group as one motion, or stage by stage if the
+    // segments cannot be joined
+    bool executeGroup(const std::vector<PipelineStage> &stages, size_t first, const std::vector<MoveGroupInterface::Plan> &plans)
+    {
+        if (plans.size() > 1)
+        {
+            std::vector<moveit_msgs::msg::RobotTrajectory> segments;
+            for (const auto &p : plans)
+            {
+                segments.push_back(p.trajectory_);
+            }
+
+            MoveGroupInterface::Plan blended = plans[0];
+            if (blender->blend(plans[0].start_state_, segments, blended.trajectory_))
+            {
+                RCLCPP_INFO(logger, "Starting %s to %s execution", stages[first].name.c_str(),
+                            stages[first + plans.size() - 1].name.c_str());
+                return execute(stages[first].name, blended, true);
+            }
+            RCLCPP_INFO(logger, "Could not join %s to %s, executing them one by one", stages[first].name.c_str(),
+                        stages[first + plans.size() - 1].name.c_str());
+        }
+
+        for (size_t i = 0; i < plans.size(); ++i)
+        {
+            RCLCPP_INFO(logger, "Starting %s execution", stages[first + i].name.c_str());
+            if (!execute(stages[first + i].name, plans[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool runBlended(const std::vector<PipelineStage> &stages)
+    {
+        size_t first = 0;
+        while (first < stages.size())
+        {
+            size_t last = first + 1;
+            while (last < stages.size() && !stages[last].before)
+            {
+                ++last;
+            }
+
+            if (stages[first].before)
+            {
+                stages[first].before();
+            }
+
+            std::vector<MoveGroupInterface::Plan> plans;
+            moveit::core::RobotStatePtr goal;
+            bool executed = false;
+            while (!executed)
+            {
+                if (!planGroup(stages, first, last, plans, goal))
+                {
+                    return false;
+                }
+
+                executed = executeGroup(stages, first, plans);
+                if (!executed)
+                {
+                    RCLCPP_INFO(logger, "%s execution failed, planning again", stages[first].name.c_str());
+                    resetToCurrentState();
+                }
+            }
+            first = last;
+        }
+        return true;
+    }
+
+public:
+    StagePipeline(MoveGroupInterface &current_group, const moveit::core::JointModelGroup *group, StagePlannerPtr stage_planner,
+                  StageExecutionPtr stage_execution, const rclcpp::Logger &log, bool ahead = true)
+        : current(current_group), jmg(group), planner(stage_planner), execution(stage_execution), logger(log), plan_ahead(ahead)
+    {
+    }
+
+    void setPlanAhead(bool ahead)
+    {
+        plan_ahead = ahead;
+    }
+
+    // null executes every stage on its own
+    void setBlender(std::shared_ptr<TrajectoryBlender> trajectory_blender)
+    {
+        blender = trajectory_blender;
+    }
+
+    // Returns false if a stage gives up; the stages before it stay executed.
+    bool run(const std::vector<PipelineStage> &stages)
+    {
+        has_last_target = false;
+        if (blender)
+        {
+            return runBlended(stages);
+        }
+
+        MoveGroupInterface::Plan current_plan;
+        moveit::core::RobotStatePtr goal;
+        bool planned = false;
+
+        for (size_t i = 0; i < stages.size(); ++i)
+        {
+            const PipelineStage &stage = stages[i];
+            if (stage.before)
+            {
+                stage.before();
+            }
+
+            bool executed = false;
+            MoveGroupInterface::Plan next;
+            moveit::core::RobotStatePtr next_goal;
+            bool next_planned = false;
+            std::vector<double> next_seed;
+
+            while (!executed)
+            {
+                if (!planned && !plan(stage, nullptr, current_plan, goal))
+                {
+                    return false;
+                }
+                planned = false;
+                // where this stage ends, the seed of the next one unless it
+                // is planned ahead
+                std::vector<double> stage_seed = seed;
+
+                RCLCPP_INFO(logger, "Starting %s execution", stage.name.c_str());
+                std::string name = stage.name;
+                MoveGroupInterface::Plan to_execute = current_plan;
+                std::future<bool> result = motion.submit([this, name, to_execute]()
+                                                         { return execute(name, to_execute); });
+
+                // one attempt only, a failure is planned again the normal way
+                bool ahead = plan_ahead && i + 1 < stages.size() && !stages[i + 1].before;
+                if (ahead)
+                {
+                    next_planned = planOnce(stages[i + 1], goal.get(), 1, next, next_goal);
+                    next_seed = seed;
+                    seed = stage_seed;
+                }
+
+                executed = result.get();
+                if (!executed)
+                {
+                    RCLCPP_INFO(logger, "%s execution failed, planning again", stage.name.c_str());
+                    next_planned = false;
+                    resetToCurrentState();
+                }
+            }
+
+            if (next_planned)
+            {
+                current_plan = next;
+                goal = next_goal;
+                seed = next_seed;
+                planned = true;
+            }
+        }
+        return true;
+    }
+};
@@ -0,0 +1,375 @@
+#pragma once
+
+#include <rclcpp/rclcpp.hpp>
+#include <moveit/move_group_interface/move_group_interface.h>
+#include <moveit/robot_state/robot_state.h>
+#include <moveit/robot_state/conversions.h>
+#include <geometry_msgs/msg/pose.hpp>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "paper_benchmarks/cartesian_fast_path.hpp"
+#include "paper_benchmarks/grasp_candidates.hpp"
+#include "paper_benchmarks/ik_service.hpp"
+#include "paper_benchmarks/path_shortcutter.hpp"
+#include "paper_benchmarks/planning_budget.hpp"
+#include "paper_benchmarks/speculative_planner.hpp"
+#include "paper_benchmarks/trajectory_cache.hpp"
+
+// The planning half of a StagePipeline as a chain of small stages. Each
+// one adds a single feature around the planner behind it and can be left
+// out of the chain on its own. A benchmark builds the chain it needs,
+// outermost first:
+//
+//   CachedPlanner -> IkPlanner -> StraightLinePlanner -> ShortcutPlanner
+//     -> BudgetedPlanner -> MoveGroupPlanner or SpeculativeStagePlanner
+//
+// IkPlanner is the only required link before the planner at the end,
+// which needs the joint goal it fills in. The stages share the components
+// they wrap, so the benchmark keeps them for the statistics.
+
+// Equivalent targets of a stage, e.g. the four yaws of a box grasp. Stages
+// sharing `choice` use the same one; the first of them to be planned picks
+// it with select_grasp() and stores its index there (-1 until then).
+struct SymmetricTarget
+{
+    std::function<std::vector<geometry_msgs::msg::Pose>()> candidates;
+    std::shared_ptr<int> choice;
+};
+
+// One planning request of a stage. The pipeline fills in the first block,
+// the stages of the chain fill in the rest on the way down.
+struct StageRequest
+{
+    std::string stage;
+    const moveit::core::JointModelGroup *group = nullptr;
+    // the state the motion starts from; with `from_current` the move group
+    // plans from its own current state, `start` is a snapshot of it
+    moveit::core::RobotStatePtr start;
+    bool from_current = false;
+    geometry_msgs::msg::Pose target;
+    SymmetricTarget symmetric;
+    // attempts <= 0 retries IK until a solution is found
+    int ik_attempts = 0;
+    // trajectories are cached under a non empty goal id
+    std::string goal_id;
+    // target of the stage planned before, if a vertical move from there may
+    // be planned as a straight line
+    geometry_msgs::msg::Pose previous_target;
+    bool has_previous_target = false;
+    // IK seed for the group, empty to keep the IK state as it is
+    std::vector<double> seed;
+
+    // joint goal of the group
+    std::vector<double> goal;
+    // planning time and attempts, <= 0 keeps the move group's
+    double planning_time = 0;
+    int planning_attempts = 0;
+    // the plan came from the cache, the target was never solved
+    bool cached = false;
+};
+
+class StagePlanner
+{
+public:
+    typedef moveit::planning_interface::MoveGroupInterface MoveGroupInterface;
+
+    virtual ~StagePlanner() {}
+
+    // a single attempt; on success `plan` starts at request.start
+    virtual bool plan(StageRequest &request, MoveGroupInterface::Plan &plan) = 0;
+};
+
+typedef std::shared_ptr<StagePlanner> StagePlannerPtr;
+
+// sets the start of the next request on `group`
+inline void set_start_state(moveit::planning_interface::MoveGroupInterface &group, const StageRequest &request)
+{
+    if (request.from_current)
+        group.setStartStateToCurrentState();
+    else
+        group.setStartState(*request.start);
+}
+
+// Plans to the joint goal through the arm's move group.
+class MoveGroupPlanner : public StagePlanner
+{
+private:
+    MoveGroupInterface &planning;
+
+public:
+    explicit MoveGroupPlanner(MoveGroupInterface &planning_group) : planning(planning_group)
+    {
+    }
+
+    bool plan(StageRequest &request, MoveGroupInterface::Plan &plan) override
+    {
+        if (request.planning_time > 0)
+            planning.setPlanningTime(request.planning_time);
+        if (request.planning_attempts > 0)
+            planning.setNumPlanningAttempts(request.planning_attempts);
+
+        set_start_state(planning, request);
+        planning.setJointValueTarget(request.group->getVariableNames(), request.goal);
+        bool success = planning.plan(plan) == moveit::core::MoveItErrorCode::SUCCESS &&
+                       !plan.trajectory_.joint_trajectory.points.empty();
+        planning.setStartStateToCurrentState();
+        return success;
+    }
+};
+
+// Races the joint goal across several planners instead of the arm's move
+// group, see SpeculativePlanner.
+class SpeculativeStagePlanner : public StagePlanner
+{
+private:
+    std::shared_ptr<SpeculativePlanner> speculative;
+
+public:
+    explicit SpeculativeStagePlanner(std::shared_ptr<SpeculativePlanner> planner) : speculative(planner)
+    {
+    }
+
+    bool plan(StageRequest &request, MoveGroupInterface::Plan &plan) override
+    {
+        return speculative->plan(*request.start, request.group->getVariableNames(), request.goal, plan, request.planning_time);
+    }
+};
+
+// Takes the planning time and attempts of every request from the history
+// of the same stage on the same arm.
+class BudgetedPlanner : public StagePlanner
+{
+private:
+    StagePlannerPtr next;
+    std::shared_ptr<PlanningBudget> budget;
+
+public:
+    BudgetedPlanner(StagePlannerPtr planner, std::shared_ptr<PlanningBudget> planning_budget)
+        : next(planner), budget(planning_budget)
+    {
+    }
+
+    bool plan(StageRequest &request, MoveGroupInterface::Plan &plan) override
+    {
+        std::string key = request.group->getName() + "/" + request.stage;
+        PlanningBudget::Budget b = budget->budget(key);
+        request.planning_time = b.time;
+        request.planning_attempts = b.attempts;
+
+        auto begin = std::chrono::steady_clock::now();
+        bool success = next->plan(request, plan);
+        budget->record(key, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count(), success);
+        return success;
+    }
+};
+
+// Shortens every trajectory the planner behind it returns.
+class ShortcutPlanner : public StagePlanner
+{
+private:
+    StagePlannerPtr next;
+    std::shared_ptr<TrajectoryShortcutter> shortcutter;
+
+public:
+    ShortcutPlanner(StagePlannerPtr planner, std::shared_ptr<TrajectoryShortcutter> trajectory_shortcutter)
+        : next(planner), shortcutter(trajectory_shortcutter)
+    {
+    }
+
+    bool plan(StageRequest &request, MoveGroupInterface::Plan &plan) override
+    {
+        if (!next->plan(request, plan))
+            return false;
+        shortcutter->process(plan.start_state_, plan.trajectory_);
+        return true;
+    }
+};
+
+// A stage that only moves straight up or down from the previous target is
+// interpolated with plan_straight_line(), and handed on to the planner
+// behind it only if that fails.
+class StraightLinePlanner : public StagePlanner
+{
+private:
+    StagePlannerPtr next;
+    MoveGroupInterface &planning;
+    rclcpp::Logger logger;
+
+public:
+    StraightLinePlanner(StagePlannerPtr planner, MoveGroupInterface &planning_group, const rclcpp::Logger &log)
+        : next(planner), planning(planning_group), logger(log)
+    {
+    }
+
+    bool plan(StageRequest &request, MoveGroupInterface::Plan &plan) override
+    {
+        if (request.has_previous_target && vertical_move(request.previous_target, request.target))
+        {
+            set_start_state(planning, request);
+            bool success = plan_straight_line(planning, request.target, plan);
+            planning.setStartStateToCurrentState();
+            if (success)
+            {
+                RCLCPP_INFO(logger, "%s: straight line in %.3f s", request.stage.c_str(), plan.planning_time_);
+                moveit::core::robotStateToRobotStateMsg(*request.start, plan.start_state_);
+                return true;
+            }
+        }
+        return next->plan(request, plan);
+    }
+};
+
+// Solves the joint goal of the request from its target. IK runs on `state`,
+// seeded from the request, through the arm's IK service if there is one.
+// A symmetric stage whose choice is still open solves all candidates from
+// the same seed and keeps the one closest to the start.
+class IkPlanner : public StagePlanner
+{
+private:
+    StagePlannerPtr next;
+    moveit::core::RobotStatePtr state;
+    std::shared_ptr<IkService> ik;
+    rclcpp::Logger logger;
+    double timeout;
+
+    // one IK attempt seeded from `state`, which is left at the solution
+    bool solveOnce(const moveit::core::JointModelGroup *jmg, const geometry_msgs::msg::Pose &target, std::vector<double> &joint_values)
+    {
+        if (!ik)
+        {
+            if (!state->setFromIK(jmg, target, timeout))
+                return false;
+            state->copyJointGroupPositions(jmg, joint_values);
+            return true;
+        }
+
+        std::vector<double> seed;
+        state->copyJointGroupPositions(jmg, seed);
+        if (!ik->solve(target, joint_values, &seed))
+            return false;
+        state->setJointGroupPositions(jmg, joint_values);
+        return true;
+    }
+
+    bool solveTarget(StageRequest &request)
+    {
+        const moveit::core::JointModelGroup *jmg = request.group;
+        int failures = 0;
+        while (!solveOnce(jmg, request.target, request.goal))
+        {
+            if (request.ik_attempts > 0 && ++failures >= request.ik_attempts)
+            {
+                RCLCPP_INFO(logger, "%s: no IK after %d attempts", request.stage.c_str(), failures);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool solveCandidates(StageRequest &request)
+    {
+        const moveit::core::JointModelGroup *jmg = request.group;
+        std::vector<double> start_values, seed;
+        request.start->copyJointGroupPositions(jmg, start_values);
+        state->copyJointGroupPositions(jmg, seed);
+        GraspIk candidate_ik = [this, jmg, &seed](const geometry_msgs::msg::Pose &pose, std::vector<double> &solution)
+        {
+            state->setJointGroupPositions(jmg, seed);
+            return solveOnce(jmg, pose, solution);
+        };
+
+        std::vector<geometry_msgs::msg::Pose> candidates = request.symmetric.candidates();
+        GraspChoice choice;
+        int failures = 0;
+        while (!select_grasp(candidates, start_values, candidate_ik, choice))
+        {
+            if (request.ik_attempts > 0 && ++failures >= request.ik_attempts)
+            {
+                RCLCPP_INFO(logger, "%s: no IK for any of %zu candidates after %d attempts", request.stage.c_str(),
+                            candidates.size(), failures);
+                state->setJointGroupPositions(jmg, seed);
+                return false;
+            }
+        }
+
+        *request.symmetric.choice = static_cast<int>(choice.index);
+        request.target = candidates[choice.index];
+        request.goal = choice.joint_values;
+        state->setJointGroupPositions(jmg, request.goal);
+        RCLCPP_INFO(logger, "%s: candidate %zu of %zu (%zu reachable), %.3f rad away", request.stage.c_str(), choice.index,
+                    candidates.size(), choice.reachable, choice.distance);
+        return true;
+    }
+
+public:
+    IkPlanner(StagePlannerPtr planner, moveit::core::RobotStatePtr ik_state, std::shared_ptr<IkService> ik_service,
+              const rclcpp::Logger &log, double ik_timeout = 0.1)
+        : next(planner), state(ik_state), ik(ik_service), logger(log), timeout(ik_timeout)
+    {
+    }
+
+    bool plan(StageRequest &request, MoveGroupInterface::Plan &plan) override
+    {
+        if (request.seed.size() == request.group->getVariableCount())
+        {
+            state->setJointGroupPositions(request.group, request.seed);
+        }
+
+        bool open_choice = request.symmetric.candidates && *request.symmetric.choice < 0;
+        if (!(open_choice ? solveCandidates(request) : solveTarget(request)))
+        {
+            return false;
+        }
+        return next->plan(request, plan);
+    }
+};
+
+// Reuses trajectories of stages with a goal id, see TrajectoryCache. A
+// miss seeds the IK with the goal cached for another start, and stores
+// what the planner behind it returns.
+class CachedPlanner : public StagePlanner
+{
+private:
+    StagePlannerPtr next;
+    std::shared_ptr<TrajectoryCache> cache;
+
+public:
+    CachedPlanner(StagePlannerPtr planner, std::shared_ptr<TrajectoryCache> trajectory_cache)
+        : next(planner), cache(trajectory_cache)
+    {
+    }
+
+    bool plan(StageRequest &request, MoveGroupInterface::Plan &plan) override
+    {
+        if (request.goal_id.empty())
+        {
+            return next->plan(request, plan);
+        }
+
+        std::vector<double> start_values;
+        request.start->copyJointGroupPositions(request.group, start_values);
+        if (cache->lookup(request.goal_id, start_values, plan.trajectory_))
+        {
+            moveit::core::robotStateToRobotStateMsg(*request.start, plan.start_state_);
+            plan.planning_time_ = 0;
+            request.cached = true;
+            return true;
+        }
+
+        std::vector<double> hint;
+        if (cache->goalHint(request.goal_id, hint))
+        {
+            request.seed = hint;
+        }
+        if (!next->plan(request, plan))
+        {
+            return false;
+        }
+        cache->store(request.goal_id, start_values, plan.trajectory_, plan.planning_time_);
+        return true;
+    }
+};
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <functional>
+#include <algorithm>
+#include "paper_benchmarks/cube_selector.hpp"
+#include "paper_benchmarks/hungarian.hpp"
+#include "paper_benchmarks/grasp_configuration_map.hpp"
+
+// Global arm-to-cube matching. Instead of every free arm greedily taking
+// the cube nearest to it, all arms are matched against a pool of candidate
+// cubes at once with the Hungarian algorithm, so two arms never compete
+// for the same cube in the middle of the table.
+
+// One arm taking part in the matching. Busy arms take part too: their
+// cube is reserved in the solution but left in the queue, so a free arm
+// does not take a cube the busy arm is much better placed for.
+struct ArmRequest
+{
+    std::string robot;
+    Point3D end_effector;
+    bool free;
+    std::vector<double> joint_values;
+
+    ArmRequest(const std::string &r, const Point3D &e, bool f = true) : robot(r), end_effector(e), free(f) {}
+};
+
+// Cost of sending an arm to a cube. Infeasible pairs return infinity.
+typedef std::function<double(const ArmRequest &, const CollisionObject &)> AssignmentCost;
+
+// Solves IK for the arm's approach pose above a cube.
+typedef std::function<bool(const ArmRequest &, const CollisionObject &, std::vector<double> &)> AssignmentIk;
+
+namespace assignment_cost
+{
+
+// straight line distance from the end effector to the cube
+inline AssignmentCost cartesian()
+{
+    return [](const ArmRequest &arm, const CollisionObject &cube)
+    {
+        double dx = cube.pose.position.x - arm.end_effector.x;
+        double dy = cube.pose.position.y - arm.end_effector.y;
+        double dz = cube.pose.position.z - arm.end_effector.z;
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    };
+}
+
+// euclidean distance between the arm's joint values and the IK solution
+// for the cube
+inline AssignmentCost jointSpace(AssignmentIk ik)
+{
+    return [ik](const ArmRequest &arm, const CollisionObject &cube)
+    {
+        std::vector<double> goal;
+        if (!ik(arm, cube, goal) || goal.size() != arm.joint_values.size())
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+        double sum = 0;
+        for (size_t i = 0; i < goal.size(); ++i)
+        {
+            sum += (goal[i] - arm.joint_values[i]) * (goal[i] - arm.joint_values[i]);
+        }
+        return std::sqrt(sum);
+    };
+}
+
+// predicted motion time: the slowest joint at its velocity limit decides
+// how long the synchronised joint motion takes
+inline AssignmentCost motionTime(AssignmentIk ik, std::vector<double> max_velocity)
+{
+    return [ik, max_velocity](const ArmRequest &arm, const CollisionObject &cube)
+    {
+        std::vector<double> goal;
+        if (!ik(arm, cube, goal) || goal.size() != arm.joint_values.size() || goal.size() != max_velocity.size())
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+        double duration = 0;
+        for (size_t i = 0; i < goal.size(); ++i)
+        {
+            duration = std::max(duration, std::fabs(goal[i] - arm.joint_values[i]) / max_velocity[i]);
+        }
+        return duration;
+    };
+}
+
+// jointSpace() without an IK call per pair: the distance to the nearest
+// sampled configuration over the cube, see GraspConfigurationMap. bases are
+// the link0 origins of robot_1 and robot_2.
+inline AssignmentCost sampledJointSpace(std::shared_ptr<const GraspConfigurationMap> map, Point3D base_1, Point3D base_2)
+{
+    return [map, base_1, base_2](const ArmRequest &arm, const CollisionObject &cube)
+    {
+        const Point3D &base = arm.robot == "robot_1" ? base_1 : base_2;
+        return map->cost(arm.joint_values, cube.pose.position.x - base.x, cube.pose.position.y - base.y);
+    };
+}
+
+} // namespace assignment_cost
+
+// Matches arms to cubes and removes the cubes assigned to free arms from the
+// queue. Candidates are the candidates_per_arm cubes nearest to each arm.
+// Returns one entry per arm; busy or unmatched arms get an object with an
+// empty id. Queue is a ThreadSafeCubeQueue or a ShardedCubeQueue.
+template <typename Queue>
+std::vector<CollisionPlanningObject> popAssignment(Queue &queue, const std::vector<ArmRequest> &arms,
+                                                   const AssignmentCost &cost, size_t candidates_per_arm = 8)
+{
+    // exhausted cubes are not excluded here since another arm may still take
+    // them; the per-arm limit is applied through the cost below
+    std::vector<CubeCandidate> candidates;
+    for (const ArmRequest &arm : arms)
+    {
+        for (CubeCandidate &candidate : queue.peekNearest(arm.end_effector, candidates_per_arm, ""))
+        {
+            auto same = [&candidate](const CubeCandidate &c)
+            { return c.shard == candidate.shard && c.slot == candidate.slot; };
+            if (std::find_if(candidates.begin(), candidates.end(), same) == candidates.end())
+            {
+                candidates.push_back(std::move(candidate));
+            }
+        }
+    }
+
+    std::vector<CollisionPlanningObject> result(arms.size());
+    if (candidates.empty())
+    {
+        return result;
+    }
+
+    // pad with "no cube" columns so every arm can be matched; real cubes
+    // always win over them unless the arm cannot do any of them
+    const double unmatched = 1e9;
+    const double exhausted_penalty = 1e6;
+    size_t rows = arms.size();
+    size_t cols = std::max(candidates.size(), rows);
+    std::vector<double> matrix(rows * cols, unmatched);
+    for (size_t r = 0; r < rows; ++r)
+    {
+        for (size_t c = 0; c < candidates.size(); ++c)
+        {
+            const CollisionPlanningObject &cube = candidates[c].cube;
+            if (!queue.reachable(arms[r].robot, cube.collisionObject))
+            {
+                continue;
+            }
+            double value = cost(arms[r], cube.collisionObject);
+            if (!std::isfinite(value))
+            {
+                continue;
+            }
+            int planned = arms[r].robot == "robot_1" ? cube.robot_1_planned_times : cube.robot_2_planned_times;
+            if (planned >= 5)
+            {
+                value += exhausted_penalty;
+            }
+            matrix[r * cols + c] = value;
+        }
+    }
+
+    std::vector<int> assignment = hungarian::solve(matrix, rows, cols);
+    for (size_t r = 0; r < rows; ++r)
+    {
+        int c = assignment[r];
+        if (!arms[r].free || c < 0 || static_cast<size_t>(c) >= candidates.size() || matrix[r * cols + c] >= unmatched)
+        {
+            continue;
+        }
+        queue.claim(candidates[c], arms[r].robot, result[r]);
+    }
+    return result;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/robot_state/robot_state.h>
+#include <moveit/robot_state/conversions.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/trajectory_processing/time_optimal_trajectory_generation.h>
+#include <moveit_msgs/msg/robot_state.hpp>
+#include <moveit_msgs/msg/robot_trajectory.hpp>
+#include <rclcpp/duration.hpp>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Joins consecutive planned segments of one group into a single trajectory,
+// so the arm does not stop at the end of every stage. The waypoints of all
+// segments are put on one path and the path is retimed with time-optimal
+// trajectory generation, whose path tolerance rounds every corner within
+// `blend_radius` (in joint space) instead of stopping at it. The timing
+// respects the velocity and acceleration bounds of the robot model, i.e.
+// joint_limits.yaml, scaled like the move group requests.
+//
+// Rounded corners leave the planned path, so the result goes through the
+// validator (a collision check against the current scene). If it is
+// rejected the segments are joined without blending, which still avoids
+// the stops between separate executions but keeps the planned path.
+// Segments between which something has to happen, such as attaching the
+// cube at the grasp point, must not be blended; the caller splits the
+// sequence there.
+class TrajectoryBlender
+{
+public:
+    typedef std::function<bool(const moveit_msgs::msg::RobotState &, const moveit_msgs::msg::RobotTrajectory &)> Validator;
+
+    struct Stats
+    {
+        size_t blended = 0;
+        size_t unblended = 0;
+        size_t failed = 0;
+        // durations of the segments executed one by one and of the results
+        double segment_time = 0;
+        double blended_time = 0;
+    };
+
+private:
+    moveit::core::RobotModelConstPtr model;
+    std::string group;
+    double blend_radius;
+    double velocity_scaling;
+    double acceleration_scaling;
+    double resample_dt;
+    Validator validator;
+    std::mutex mutex;
+    Stats stats;
+
+    static double duration(const moveit_msgs::msg::RobotTrajectory &trajectory)
+    {
+        const auto &points = trajectory.joint_trajectory.points;
+        return points.empty() ? 0 : rclcpp::Duration(points.back().time_from_start).seconds();
+    }
+
+    bool retime(const moveit_msgs::msg::RobotState &start, const std::vector<moveit_msgs::msg::RobotTrajectory> &segments,
+                double tolerance, moveit_msgs::msg::RobotTrajectory &out) const
+    {
+        moveit::core::RobotState state(model);
+        moveit::core::robotStateMsgToRobotState(start, state);
+        robot_trajectory::RobotTrajectory path(model, group);
+
+        for (size_t s = 0; s < segments.size(); ++s)
+        {
+            const auto &joints = segments[s].joint_trajectory;
+            // every segment starts where the previous one ended
+            for (size_t i = s == 0 ? 0 : 1; i < joints.points.size(); ++i)
+            {
+                state.setVariablePositions(joints.joint_names, joints.points[i].positions);
+                path.addSuffixWayPoint(state, 0.0);
+            }
+        }
+        if (path.getWayPointCount() < 2)
+        {
+            return false;
+        }
+
+        trajectory_processing::TimeOptimalTrajectoryGeneration totg(tolerance, resample_dt);
+        if (!totg.computeTimeStamps(path, velocity_scaling, acceleration_scaling))
+        {
+            return false;
+        }
+        path.getRobotTrajectoryMsg(out);
+        return true;
+    }
+
+public:
+    TrajectoryBlender(const moveit::core::RobotModelConstPtr &robot_model, const std::string &group_name, double radius = 0.05,
+                      double max_velocity_scaling = 1.0, double max_acceleration_scaling = 1.0, double dt = 0.02)
+        : model(robot_model), group(group_name), blend_radius(radius), velocity_scaling(max_velocity_scaling),
+          acceleration_scaling(max_acceleration_scaling), resample_dt(dt)
+    {
+    }
+
+    void setValidator(Validator check)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        validator = check;
+    }
+
+    // Joins `segments`, the first starting at `start`, into `out`. False if
+    // not even the unblended join could be timed; `out` is undefined then.
+    bool blend(const moveit_msgs::msg::RobotState &start, const std::vector<moveit_msgs::msg::RobotTrajectory> &segments,
+               moveit_msgs::msg::RobotTrajectory &out)
+    {
+        Validator check;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            check = validator;
+        }
+
+        double segment_time = 0;
+        for (const auto &segment : segments)
+        {
+            segment_time += duration(segment);
+        }
+
+        bool blended = retime(start, segments, blend_radius, out) && (!check || check(start, out));
+        bool joined = blended || retime(start, segments, 1e-3, out);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!joined)
+        {
+            stats.failed++;
+            return false;
+        }
+        (blended ? stats.blended : stats.unblended)++;
+        stats.segment_time += segment_time;
+        stats.blended_time += duration(out);
+        return true;
+    }
+
+    Stats statistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+};
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <moveit_msgs/msg/robot_trajectory.hpp>
+#include <cmath>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Planned trajectories keyed by goal (e.g. tray slot and stage) and the
+// start joint values quantised to `resolution`. Once a motion has been
+// planned from a start configuration to a goal it is replayed instead of
+// planned again. That only pays off where the same goal is reached from the
+// same start repeatedly; the tray stages of one benchmark run visit every
+// slot once and start above a different cube each time, so hits are rare
+// there. The quantised key only finds the candidate; a hit also needs every start
+// joint within `tolerance` of the stored start, so the trajectory still
+// starts where the arm is, and it has to pass the validity check against
+// the current planning scene.
+//
+// For every goal the cache also remembers the joint values the last
+// trajectory ended in. Seeding IK with them makes the solver return the
+// same configuration for the same slot, which keeps the starts of the
+// following stages repeatable. The least recently used trajectory is
+// dropped once `capacity` entries are stored.
+class TrajectoryCache
+{
+public:
+    typedef std::function<bool(const std::vector<double> &start, const moveit_msgs::msg::RobotTrajectory &)> Validator;
+
+    struct Stats
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t rejected = 0;
+        double planning_time_saved = 0;
+    };
+
+private:
+    struct Entry
+    {
+        std::string key;
+        std::vector<double> start;
+        moveit_msgs::msg::RobotTrajectory trajectory;
+        double planning_time;
+    };
+
+    double resolution;
+    double tolerance;
+    size_t capacity;
+    Validator validator;
+
+    std::mutex mutex;
+    std::list<Entry> lru;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    std::map<std::string, std::vector<double>> goals;
+    Stats stats;
+
+    std::string key(const std::string &goal, const std::vector<double> &start) const
+    {
+        std::string k = goal;
+        for (double v : start)
+        {
+            k += ':';
+            k += std::to_string(static_cast<long>(std::lround(v / resolution)));
+        }
+        return k;
+    }
+
+public:
+    explicit TrajectoryCache(double quantisation = 0.01, double start_tolerance = 0.005, size_t max_entries = 1024)
+        : resolution(quantisation), tolerance(start_tolerance), capacity(max_entries)
+    {
+    }
+
+    // checks a stored trajectory before it is handed out, e.g. against
+    // the planning scene; without one every candidate is accepted
+    void setValidator(Validator v)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        validator = v;
+    }
+
+    bool lookup(const std::string &goal, const std::vector<double> &start, moveit_msgs::msg::RobotTrajectory &trajectory)
+    {
+        Validator check;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(key(goal, start));
+            bool close = it != index.end() && it->second->start.size() == start.size();
+            for (size_t i = 0; close && i < start.size(); ++i)
+            {
+                close = std::fabs(it->second->start[i] - start[i]) <= tolerance;
+            }
+            if (!close)
+            {
+                stats.misses++;
+                return false;
+            }
+            trajectory = it->second->trajectory;
+            check = validator;
+        }
+
+        // the scene check may take a while, keep the cache unlocked for it
+        bool valid = !check || check(start, trajectory);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key(goal, start));
+        if (!valid)
+        {
+            // something moved into the way, plan fresh and replace it
+            if (it != index.end())
+            {
+                lru.erase(it->second);
+                index.erase(it);
+            }
+            stats.rejected++;
+            stats.misses++;
+            return false;
+        }
+        stats.hits++;
+        if (it != index.end())
+        {
+            stats.planning_time_saved += it->second->planning_time;
+            lru.splice(lru.begin(), lru, it->second);
+        }
+        return true;
+    }
+
+    void store(const std::string &goal, const std::vector<double> &start, const moveit_msgs::msg::RobotTrajectory &trajectory,
+               double planning_time)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string k = key(goal, start);
+        auto it = index.find(k);
+        if (it != index.end())
+        {
+            lru.erase(it->second);
+            index.erase(it);
+        }
+        else if (lru.size() >= capacity)
+        {
+            index.erase(lru.back().key);
+            lru.pop_back();
+        }
+        Entry entry;
+        entry.key = k;
+        entry.start = start;
+        entry.trajectory = trajectory;
+        entry.planning_time = planning_time;
+        lru.push_front(entry);
+        index[k] = lru.begin();
+
+        if (!trajectory.joint_trajectory.points.empty())
+        {
+            goals[goal] = trajectory.joint_trajectory.points.back().positions;
+        }
+    }
+
+    // joint values the last trajectory to this goal ended in
+    bool goalHint(const std::string &goal, std::vector<double> &joint_values)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = goals.find(goal);
+        if (it == goals.end())
+        {
+            return false;
+        }
+        joint_values = it->second;
+        return true;
+    }
+
+    Stats statistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+};
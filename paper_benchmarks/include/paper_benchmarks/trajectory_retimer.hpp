@@ -0,0 +1,149 @@
+#pragma once
+
+#include <moveit/robot_model/robot_model.h>
+#include <moveit/robot_state/robot_state.h>
+#include <moveit/robot_state/conversions.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/trajectory_processing/time_optimal_trajectory_generation.h>
+#include <moveit/trajectory_processing/ruckig_traj_smoothing.h>
+#include <moveit_msgs/msg/robot_state.hpp>
+#include <moveit_msgs/msg/robot_trajectory.hpp>
+#include <rclcpp/duration.hpp>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Speed of one stage as fractions of the joint limits.
+struct StageScaling
+{
+    double velocity = 1.0;
+    double acceleration = 1.0;
+
+    StageScaling() {}
+    StageScaling(double v, double a) : velocity(v), acceleration(a) {}
+};
+
+// Times a planned trajectory again between planning and execution. The
+// move groups scale every motion down by the same factor; here each stage
+// gets its own scaling instead, so the transit motions can use the full
+// limits of joint_limits.yaml while the motions down to the cube and into
+// the tray stay slow. The path is retimed with time-optimal trajectory
+// generation and then jerk limited with Ruckig, which only stretches the
+// timing where the jerk would be too high.
+//
+// The path tolerance is small, so the geometry stays that of the plan; the
+// result is still checked by the validator, and a trajectory that fails
+// the check or cannot be timed is executed as planned.
+class TrajectoryRetimer
+{
+public:
+    typedef std::function<bool(const moveit_msgs::msg::RobotState &, const moveit_msgs::msg::RobotTrajectory &)> Validator;
+
+    struct Stats
+    {
+        size_t retimed = 0;
+        size_t kept = 0;
+        double planned_time = 0;
+        double retimed_time = 0;
+    };
+
+private:
+    moveit::core::RobotModelConstPtr model;
+    std::string group;
+    StageScaling default_scaling;
+    std::map<std::string, StageScaling> scaling;
+    bool limit_jerk;
+    double path_tolerance;
+    double resample_dt;
+    Validator validator;
+    std::mutex mutex;
+    std::map<std::string, Stats> stats;
+
+    static double duration(const moveit_msgs::msg::RobotTrajectory &trajectory)
+    {
+        const auto &points = trajectory.joint_trajectory.points;
+        return points.empty() ? 0 : rclcpp::Duration(points.back().time_from_start).seconds();
+    }
+
+public:
+    TrajectoryRetimer(const moveit::core::RobotModelConstPtr &robot_model, const std::string &group_name,
+                      StageScaling scale = StageScaling(), bool jerk = true, double tolerance = 0.001, double dt = 0.02)
+        : model(robot_model), group(group_name), default_scaling(scale), limit_jerk(jerk), path_tolerance(tolerance),
+          resample_dt(dt)
+    {
+    }
+
+    // scaling of the stages with this name, the default for all others
+    void setScaling(const std::string &stage, StageScaling scale)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        scaling[stage] = scale;
+    }
+
+    void setValidator(Validator check)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        validator = check;
+    }
+
+    // Retimes `trajectory`, which starts at `start`, with the scaling of
+    // `stage`. Returns false and leaves it as it is if that fails.
+    bool retime(const std::string &stage, const moveit_msgs::msg::RobotState &start, moveit_msgs::msg::RobotTrajectory &trajectory)
+    {
+        StageScaling scale = default_scaling;
+        Validator check;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = scaling.find(stage);
+            if (it != scaling.end())
+            {
+                scale = it->second;
+            }
+            check = validator;
+        }
+
+        moveit::core::RobotState state(model);
+        moveit::core::robotStateMsgToRobotState(start, state);
+        robot_trajectory::RobotTrajectory path(model, group);
+        path.setRobotTrajectoryMsg(state, trajectory);
+
+        moveit_msgs::msg::RobotTrajectory retimed;
+        bool success = path.getWayPointCount() >= 2;
+        if (success)
+        {
+            trajectory_processing::TimeOptimalTrajectoryGeneration totg(path_tolerance, resample_dt);
+            success = totg.computeTimeStamps(path, scale.velocity, scale.acceleration);
+        }
+        if (success && limit_jerk)
+        {
+            success = trajectory_processing::RuckigSmoothing::applySmoothing(path, scale.velocity, scale.acceleration);
+        }
+        if (success)
+        {
+            path.getRobotTrajectoryMsg(retimed);
+            success = !check || check(start, retimed);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Stats &s = stats[stage];
+        if (!success)
+        {
+            s.kept++;
+            return false;
+        }
+        s.retimed++;
+        s.planned_time += duration(trajectory);
+        s.retimed_time += duration(retimed);
+        trajectory = retimed;
+        return true;
+    }
+
+    // per stage name
+    std::map<std::string, Stats> statistics()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+};
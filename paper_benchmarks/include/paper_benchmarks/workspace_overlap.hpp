@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <initializer_list>
+#include <limits>
+#include "paper_benchmarks/cube_selector.hpp"
+
+// Roughly the part of the table an arm works in during one pick and place,
+// as a box in the xy plane around the arm's base, the cube and the tray
+// slot, grown by `margin` for the links, the gripper and the cube. This is
+// a heuristic for scheduling, not a guarantee: nothing keeps the planned
+// path inside the box and the elbow can swing out of it. Disjoint boxes
+// mean the two tasks are far enough apart to run independently, with the
+// planner and the scene still keeping the arms apart; overlapping boxes
+// mean both arms reach into the shared middle of the table. The test is a
+// handful of comparisons, cheap enough to run on every dispatch.
+struct WorkspaceBox
+{
+    double min_x = std::numeric_limits<double>::infinity();
+    double min_y = std::numeric_limits<double>::infinity();
+    double max_x = -std::numeric_limits<double>::infinity();
+    double max_y = -std::numeric_limits<double>::infinity();
+
+    bool empty() const
+    {
+        return min_x > max_x || min_y > max_y;
+    }
+
+    bool overlaps(const WorkspaceBox &other) const
+    {
+        if (empty() || other.empty())
+            return false;
+        return min_x <= other.max_x && other.min_x <= max_x && min_y <= other.max_y && other.min_y <= max_y;
+    }
+};
+
+inline WorkspaceBox task_workspace(const Point3D &base, const Point3D &cube, const Point3D &slot, double margin = 0.15)
+{
+    WorkspaceBox box;
+    for (const Point3D &p : {base, cube, slot})
+    {
+        box.min_x = std::min(box.min_x, static_cast<double>(p.x) - margin);
+        box.min_y = std::min(box.min_y, static_cast<double>(p.y) - margin);
+        box.max_x = std::max(box.max_x, static_cast<double>(p.x) + margin);
+        box.max_y = std::max(box.max_y, static_cast<double>(p.y) + margin);
+    }
+    return box;
+}
@@ -16,6 +16,54 @@ def generate_launch_description():
         "cubesToPick", default_value=TextSubstitution(text="5")
     )
 
+    reachability_arg = DeclareLaunchArgument(
+        "reachabilityMapDirectory", default_value=TextSubstitution(text="")
+    )
+
+    launch_type_arg = DeclareLaunchArgument(
+        "launchType", default_value=TextSubstitution(text="euclideanDistance")
+    )
+
+    assignment_cost_arg = DeclareLaunchArgument(
+        "assignmentCost", default_value=TextSubstitution(text="cartesian")
+    )
+
+    plan_ahead_arg = DeclareLaunchArgument(
+        "planAhead", default_value=TextSubstitution(text="true")
+    )
+
+    cache_trajectories_arg = DeclareLaunchArgument(
+        "cacheTrajectories", default_value=TextSubstitution(text="false")
+    )
+
+    blend_segments_arg = DeclareLaunchArgument(
+        "blendSegments", default_value=TextSubstitution(text="false")
+    )
+
+    retime_trajectories_arg = DeclareLaunchArgument(
+        "retimeTrajectories", default_value=TextSubstitution(text="false")
+    )
+
+    shortcut_paths_arg = DeclareLaunchArgument(
+        "shortcutPaths", default_value=TextSubstitution(text="false")
+    )
+
+    speculative_planning_arg = DeclareLaunchArgument(
+        "speculativePlanning", default_value=TextSubstitution(text="false")
+    )
+
+    adaptive_budget_arg = DeclareLaunchArgument(
+        "adaptiveBudget", default_value=TextSubstitution(text="false")
+    )
+
+    reserve_motions_arg = DeclareLaunchArgument(
+        "reserveMotions", default_value=TextSubstitution(text="false")
+    )
+
+    scheduling_mode_arg = DeclareLaunchArgument(
+        "schedulingMode", default_value=TextSubstitution(text="independent")
+    )
+
     # Start the actual move_group node/action server
     move_group_node = Node(
         package="paper_benchmarks",
@@ -23,7 +71,18 @@ def generate_launch_description():
         output="screen",
         parameters=[
             moveit_config.to_dict(),
-            {"launchType" : "euclideanDistance"},
+            {"launchType" : LaunchConfiguration("launchType")},
+            {"reachabilityMapDirectory" : LaunchConfiguration("reachabilityMapDirectory")},
+            {"assignmentCost" : LaunchConfiguration("assignmentCost")},
+            {"planAhead" : LaunchConfiguration("planAhead")},
+            {"cacheTrajectories" : LaunchConfiguration("cacheTrajectories")},
+            {"blendSegments" : LaunchConfiguration("blendSegments")},
+            {"retimeTrajectories" : LaunchConfiguration("retimeTrajectories")},
+            {"shortcutPaths" : LaunchConfiguration("shortcutPaths")},
+            {"speculativePlanning" : LaunchConfiguration("speculativePlanning")},
+            {"adaptiveBudget" : LaunchConfiguration("adaptiveBudget")},
+            {"reserveMotions" : LaunchConfiguration("reserveMotions")},
+            {"schedulingMode" : LaunchConfiguration("schedulingMode")},
             {"cubesToPick" : LaunchConfiguration("cubesToPick")}
         ],
     )
@@ -40,5 +99,17 @@ def generate_launch_description():
     ld.add_action(start_scene)   
     ld.add_action(move_group_node)
     ld.add_action(background_r_launch_arg)
+    ld.add_action(launch_type_arg)
+    ld.add_action(reachability_arg)
+    ld.add_action(assignment_cost_arg)
+    ld.add_action(plan_ahead_arg)
+    ld.add_action(cache_trajectories_arg)
+    ld.add_action(blend_segments_arg)
+    ld.add_action(retime_trajectories_arg)
+    ld.add_action(shortcut_paths_arg)
+    ld.add_action(speculative_planning_arg)
+    ld.add_action(adaptive_budget_arg)
+    ld.add_action(reserve_motions_arg)
+    ld.add_action(scheduling_mode_arg)
 
     return ld   
\ No newline at end of file
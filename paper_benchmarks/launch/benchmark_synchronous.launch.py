@@ -17,6 +17,26 @@ def generate_launch_description():
         "cubesToPick", default_value=TextSubstitution(text="5")
     )
 
+    reachability_arg = DeclareLaunchArgument(
+        "reachabilityMapDirectory", default_value=TextSubstitution(text="")
+    )
+
+    launch_type_arg = DeclareLaunchArgument(
+        "launchType", default_value=TextSubstitution(text="euclideanDistance")
+    )
+
+    blend_segments_arg = DeclareLaunchArgument(
+        "blendSegments", default_value=TextSubstitution(text="false")
+    )
+
+    planning_mode_arg = DeclareLaunchArgument(
+        "planningMode", default_value=TextSubstitution(text="joint")
+    )
+
+    pipeline_execution_arg = DeclareLaunchArgument(
+        "pipelineExecution", default_value=TextSubstitution(text="false")
+    )
+
     # Start the actual move_group node/action server
     move_group_node = Node(
         package="paper_benchmarks",
@@ -24,6 +44,11 @@ def generate_launch_description():
         output="screen",
         parameters=[
             moveit_config.to_dict(),
+            {"launchType" : LaunchConfiguration("launchType")},
+            {"reachabilityMapDirectory" : LaunchConfiguration("reachabilityMapDirectory")},
+            {"blendSegments" : LaunchConfiguration("blendSegments")},
+            {"planningMode" : LaunchConfiguration("planningMode")},
+            {"pipelineExecution" : LaunchConfiguration("pipelineExecution")},
             {"cubesToPick" : LaunchConfiguration("cubesToPick")}
         ],
     )
@@ -40,5 +65,10 @@ def generate_launch_description():
     ld.add_action(start_scene)   
     ld.add_action(move_group_node)    
     ld.add_action(background_r_launch_arg)
+    ld.add_action(launch_type_arg)
+    ld.add_action(reachability_arg)
+    ld.add_action(blend_segments_arg)
+    ld.add_action(planning_mode_arg)
+    ld.add_action(pipeline_execution_arg)
 
     return ld   
\ No newline at end of file
@@ -0,0 +1,33 @@
+from launch import LaunchDescription
+from launch_ros.actions import Node
+from moveit_configs_utils import MoveItConfigsBuilder
+from launch.actions import DeclareLaunchArgument
+from launch.substitutions import TextSubstitution
+from launch.substitutions import LaunchConfiguration
+
+
+def generate_launch_description():
+    moveit_config = MoveItConfigsBuilder("panda", package_name="panda_moveit_config").to_moveit_configs()
+
+    output_directory_arg = DeclareLaunchArgument(
+        "outputDirectory", default_value=TextSubstitution(text=".")
+    )
+
+    # Sample both arms and write panda_1.reach / panda_2.reach
+    reachability_node = Node(
+        package="paper_benchmarks",
+        executable="build_reachability_map",
+        output="screen",
+        parameters=[
+            moveit_config.to_dict(),
+            {"outputDirectory" : LaunchConfiguration("outputDirectory")}
+        ],
+    )
+
+    # Create the launch description and populate
+    ld = LaunchDescription()
+
+    ld.add_action(output_directory_arg)
+    ld.add_action(reachability_node)
+
+    return ld
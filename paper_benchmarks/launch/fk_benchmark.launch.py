@@ -0,0 +1,33 @@
+from launch import LaunchDescription
+from launch_ros.actions import Node
+from moveit_configs_utils import MoveItConfigsBuilder
+from launch.actions import DeclareLaunchArgument
+from launch.substitutions import TextSubstitution
+from launch.substitutions import LaunchConfiguration
+
+
+def generate_launch_description():
+    moveit_config = MoveItConfigsBuilder("panda", package_name="panda_moveit_config").to_moveit_configs()
+
+    configurations_arg = DeclareLaunchArgument(
+        "configurations", default_value=TextSubstitution(text="100000")
+    )
+
+    # batch FK against RobotState on random configurations of panda_1
+    benchmark_node = Node(
+        package="paper_benchmarks",
+        executable="fk_benchmark",
+        output="screen",
+        parameters=[
+            moveit_config.to_dict(),
+            {"configurations" : LaunchConfiguration("configurations")}
+        ],
+    )
+
+    # Create the launch description and populate
+    ld = LaunchDescription()
+
+    ld.add_action(configurations_arg)
+    ld.add_action(benchmark_node)
+
+    return ld
@@ -0,0 +1,33 @@
+from launch import LaunchDescription
+from launch_ros.actions import Node
+from moveit_configs_utils import MoveItConfigsBuilder
+from launch.actions import DeclareLaunchArgument
+from launch.substitutions import TextSubstitution
+from launch.substitutions import LaunchConfiguration
+
+
+def generate_launch_description():
+    moveit_config = MoveItConfigsBuilder("panda", package_name="panda_moveit_config").to_moveit_configs()
+
+    timeout_arg = DeclareLaunchArgument(
+        "timeout", default_value=TextSubstitution(text="0.05")
+    )
+
+    # KDL against the analytic plugin over the table workspace of both arms
+    benchmark_node = Node(
+        package="paper_benchmarks",
+        executable="ik_solver_benchmark",
+        output="screen",
+        parameters=[
+            moveit_config.to_dict(),
+            {"timeout" : LaunchConfiguration("timeout")}
+        ],
+    )
+
+    # Create the launch description and populate
+    ld = LaunchDescription()
+
+    ld.add_action(timeout_arg)
+    ld.add_action(benchmark_node)
+
+    return ld
@@ -0,0 +1,34 @@
+from launch import LaunchDescription
+from launch_ros.actions import Node
+from moveit_configs_utils import MoveItConfigsBuilder
+from launch.actions import DeclareLaunchArgument
+from launch.substitutions import TextSubstitution
+from launch.substitutions import LaunchConfiguration
+
+
+def generate_launch_description():
+    moveit_config = MoveItConfigsBuilder("panda", package_name="panda_moveit_config").to_moveit_configs()
+
+    requests_arg = DeclareLaunchArgument(
+        "requests", default_value=TextSubstitution(text="50")
+    )
+
+    # dual_arm planning against decoupled planning on the same goals;
+    # needs the move group and the scene running
+    benchmark_node = Node(
+        package="paper_benchmarks",
+        executable="planning_ablation_benchmark",
+        output="screen",
+        parameters=[
+            moveit_config.to_dict(),
+            {"requests" : LaunchConfiguration("requests")}
+        ],
+    )
+
+    # Create the launch description and populate
+    ld = LaunchDescription()
+
+    ld.add_action(requests_arg)
+    ld.add_action(benchmark_node)
+
+    return ld
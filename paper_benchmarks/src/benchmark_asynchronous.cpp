@@ -1,7 +1,10 @@
 #include "paper_benchmarks/benchmark_asynchronous.hpp"
+#include <future>
 #include <thread>
 #include <iostream>
+#include <map>
 #include <string>
+#include <geometric_shapes/shape_operations.h>
 #include "std_msgs/msg/string.hpp"
 #include "paper_benchmarks/cube_selector.hpp"
 
@@ -18,13 +21,16 @@ struct arm_state
     arm_state(const moveit::core::JointModelGroup *jmg) : arm_joint_model_group(jmg), arm_joint_names(jmg->getVariableNames()) {}
 };
 
-bool advancedExecuteTrajectory(arm_state &arm_1_state, moveit::planning_interface::MoveGroupInterface &panda_1_arm,  
-  moveit::core::RobotModelConstPtr kinematic_model, moveit::core::RobotStatePtr kinematic_state, 
-  moveit_msgs::msg::CollisionObject &object, tray_helper *tray, int s);
+bool advancedExecuteTrajectory(StagePipeline &pipeline, moveit_msgs::msg::CollisionObject &object, tray_helper *tray, int s);
+bool coordinatedExecuteTrajectory(moveit::planning_interface::MoveGroupInterface &dual_arm, moveit_msgs::msg::CollisionObject &object_1,
+                                  tray_helper *tray_1, moveit_msgs::msg::CollisionObject &object_2, tray_helper *tray_2);
 
 
 int number_of_test_cases = 5;
 
+// IK attempts per stage before a cube that is not grasped yet is handed back
+const int max_ik_attempts = 5;
+
 static struct runner{
   int counter = 0;
   std::mutex mtx;
@@ -46,14 +52,47 @@ int main(int argc, char **argv)
 
   node = std::make_shared<rclcpp::Node>("benchmark_asynchronous");
 
-  node->declare_parameter("launchType", "randomDistance");
+  node->declare_parameter("launchType", "euclideanDistance");
+  node->declare_parameter("assignmentCost", "cartesian");
+  node->declare_parameter("reachabilityMapDirectory", "");
   node->declare_parameter("cubesToPick", 5);
-
-  std::string distanceType = node->get_parameter("launchType").as_string();
+  node->declare_parameter("planAhead", true);
+  node->declare_parameter("cacheTrajectories", false);
+  node->declare_parameter("blendSegments", false);
+  node->declare_parameter("retimeTrajectories", false);
+  node->declare_parameter("shortcutPaths", false);
+  node->declare_parameter("speculativePlanning", false);
+  node->declare_parameter("adaptiveBudget", false);
+  node->declare_parameter("reserveMotions", false);
+  node->declare_parameter("schedulingMode", "independent");
+
+  distanceType = node->get_parameter("launchType").as_string();
+  assignmentCost = node->get_parameter("assignmentCost").as_string();
   
   number_of_test_cases = node->get_parameter("cubesToPick").as_int();
+  planAhead = node->get_parameter("planAhead").as_bool();
+  cacheTrajectories = node->get_parameter("cacheTrajectories").as_bool();
+  blendSegments = node->get_parameter("blendSegments").as_bool();
+  retimeTrajectories = node->get_parameter("retimeTrajectories").as_bool();
+  shortcutPaths = node->get_parameter("shortcutPaths").as_bool();
+  speculativePlanning = node->get_parameter("speculativePlanning").as_bool();
+  adaptiveBudget = node->get_parameter("adaptiveBudget").as_bool();
+  reserveMotions = node->get_parameter("reserveMotions").as_bool();
+  schedulingMode = node->get_parameter("schedulingMode").as_string();
 
   RCLCPP_INFO(LOGGER, "launch: %s", distanceType.c_str());
+  RCLCPP_INFO(LOGGER, "assignment cost: %s", assignmentCost.c_str());
+  RCLCPP_INFO(LOGGER, "plan ahead: %s", planAhead ? "true" : "false");
+  RCLCPP_INFO(LOGGER, "cache trajectories: %s", cacheTrajectories ? "true" : "false");
+  RCLCPP_INFO(LOGGER, "blend segments: %s", blendSegments ? "true" : "false");
+  RCLCPP_INFO(LOGGER, "retime trajectories: %s", retimeTrajectories ? "true" : "false");
+  RCLCPP_INFO(LOGGER, "shortcut paths: %s", shortcutPaths ? "true" : "false");
+  RCLCPP_INFO(LOGGER, "speculative planning: %s", speculativePlanning ? "true" : "false");
+  RCLCPP_INFO(LOGGER, "adaptive budget: %s", adaptiveBudget ? "true" : "false");
+  RCLCPP_INFO(LOGGER, "reserve motions: %s", reserveMotions ? "true" : "false");
+  RCLCPP_INFO(LOGGER, "scheduling mode: %s", schedulingMode.c_str());
+
+  load_reachability_maps(objs, node->get_parameter("reachabilityMapDirectory").as_string(), LOGGER);
 
   pnp_1 = std::make_shared<primitive_pick_and_place>(node, "panda_1");
   pnp_2 = std::make_shared<primitive_pick_and_place>(node, "panda_2");
@@ -93,6 +132,9 @@ void update_planning_scene()
       }
     }
 
+    // wake the dispatcher for the new cubes
+    dispatcher.notify();
+
     if(objs.size() < 4)
     {
       auto message = std_msgs::msg::String();
@@ -128,6 +170,18 @@ void main_thread()
   panda_2_arm.setNumPlanningAttempts(5);
   panda_2_arm.setPlanningTime(1);
 
+  // the pipelines plan ahead while the arm executes; a MoveGroupInterface
+  // is not thread safe, so planning goes through an interface of its own
+  moveit::planning_interface::MoveGroupInterface panda_1_planning(node, "panda_1");
+  moveit::planning_interface::MoveGroupInterface panda_2_planning(node, "panda_2");
+  for (auto *group : {&panda_1_planning, &panda_2_planning})
+  {
+    group->setMaxVelocityScalingFactor(0.50);
+    group->setMaxAccelerationScalingFactor(0.50);
+    group->setNumPlanningAttempts(5);
+    group->setPlanningTime(1);
+  }
+
   moveit::core::RobotModelConstPtr kinematic_model = panda_1_arm.getRobotModel();
   moveit::core::RobotStatePtr kinematic_state = panda_1_arm.getCurrentState();
 
@@ -136,6 +190,57 @@ void main_thread()
 
   arm_state arm_1_state(kinematic_model->getJointModelGroup("panda_1"));
   arm_state arm_2_state(kinematic_model_2->getJointModelGroup("panda_2"));
+
+  // the assignment solver runs IK on its own state, the arm threads own
+  // kinematic_state and kinematic_state_2. IK is seeded from the arm's
+  // current joints and solved once per arm and cube: the cubes lie still
+  // until they are picked, so later dispatches reuse the approach
+  // configuration instead of solving it on the dispatcher thread again.
+  moveit::core::RobotStatePtr assignment_state = std::make_shared<moveit::core::RobotState>(*kinematic_state);
+  std::map<std::string, std::pair<bool, std::vector<double>>> assignment_ik_cache;
+  AssignmentIk assignment_ik = [&](const ArmRequest &arm, const CollisionObject &cube, std::vector<double> &joint_values)
+  {
+    auto cached = assignment_ik_cache.find(arm.robot + "/" + cube.id);
+    if (cached == assignment_ik_cache.end())
+    {
+      const moveit::core::JointModelGroup *jmg = arm.robot == "robot_1" ? arm_1_state.arm_joint_model_group : arm_2_state.arm_joint_model_group;
+      if (arm.joint_values.size() == jmg->getVariableCount())
+      {
+        assignment_state->setJointGroupPositions(jmg, arm.joint_values);
+      }
+      std::pair<bool, std::vector<double>> solution;
+      solution.first = assignment_state->setFromIK(jmg, approach_pose(cube, 0.25), 0.05);
+      if (solution.first)
+      {
+        assignment_state->copyJointGroupPositions(jmg, solution.second);
+      }
+      cached = assignment_ik_cache.emplace(arm.robot + "/" + cube.id, solution).first;
+    }
+    joint_values = cached->second.second;
+    return cached->second.first;
+  };
+
+  std::vector<double> max_velocity;
+  for (const std::string &name : arm_1_state.arm_joint_names)
+  {
+    max_velocity.push_back(kinematic_model->getVariableBounds(name).max_velocity_);
+  }
+
+  AssignmentCost assignment_cost = assignment_cost::cartesian();
+  if (assignmentCost == "jointSpace")
+    assignment_cost = assignment_cost::jointSpace(assignment_ik);
+  else if (assignmentCost == "motionTime")
+    assignment_cost = assignment_cost::motionTime(assignment_ik, max_velocity);
+  else if (assignmentCost == "sampledJointSpace")
+  {
+    // both arms are the same, one map in the link0 frame serves both; the
+    // height is the approach pose above a cube on the table
+    auto start = std::chrono::steady_clock::now();
+    auto map = std::make_shared<const GraspConfigurationMap>(0.276);
+    RCLCPP_INFO(LOGGER, "[metric] grasp configuration map: %zu configurations in %.3f s", map->size(),
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    assignment_cost = assignment_cost::sampledJointSpace(map, Point3D(0, -0.5, 1), Point3D(0, 0.5, 1));
+  }
   
   
   while (!update_scene_called_once)
@@ -145,403 +250,743 @@ void main_thread()
 
   RCLCPP_INFO(LOGGER, "Size: %li", objs.size());
 
-  int i = 0;
-
   RCLCPP_INFO(LOGGER, "[checkpoint] Starting execution");
 
-  bool planned_for_panda_1 = false;
-  bool planned_for_panda_2 = false;
-
-  while (!objs.empty())
+  // the cache, blender, retimer, shortcutter and reservation table check
+  // their trajectories against the scene as it is now, with the other arm
+  // and the attached cube where they currently are; without any of them
+  // nothing reads the scene and the monitor is not started
+  planning_scene_monitor::PlanningSceneMonitorPtr scene_monitor;
+  if (cacheTrajectories || blendSegments || retimeTrajectories || shortcutPaths || reserveMotions)
   {
-    CollisionPlanningObject current_object;
-    std::string curren_planning_robot = "robot_1";  
-
-    // start planning if atleast one of the arms are available
-    if (!panda_1_busy || !panda_2_busy)
-    {
-      // change end effector position based on the robot available
-      if (!panda_1_busy)
-      {
-        e.x = 0;
-        e.y = -0.5;
-        e.z = 1;
-        curren_planning_robot = "robot_1";
-      }
-      else //if (!planned_for_panda_2)
-      {
-        e.x = 0;
-        e.y = 0.5;
-        e.z = 1;
-        curren_planning_robot = "robot_2";
-      }
+    scene_monitor = std::make_shared<planning_scene_monitor::PlanningSceneMonitor>(node, "robot_description");
+    scene_monitor->startSceneMonitor();
+    scene_monitor->startStateMonitor();
+    scene_monitor->requestPlanningSceneState();
+  }
 
-      objs.updatePoint(e);
-      //current_object = objs.pop(curren_planning_robot, "random");
-      current_object = objs.pop(curren_planning_robot, "");
+  std::shared_ptr<TrajectoryCache> trajectory_cache;
+  if (cacheTrajectories)
+  {
+    trajectory_cache = std::make_shared<TrajectoryCache>();
+    trajectory_cache->setValidator([scene_monitor](const std::vector<double> &, const moveit_msgs::msg::RobotTrajectory &trajectory)
+                                   {
+      planning_scene_monitor::LockedPlanningSceneRO scene(scene_monitor);
+      moveit_msgs::msg::RobotState start;
+      moveit::core::robotStateToRobotStateMsg(scene->getCurrentState(), start);
+      return scene->isPathValid(start, trajectory); });
+  }
 
+  // same scaling as the move groups above; the rounded corners are checked
+  // against the scene before the joined motion is sent
+  TrajectoryBlender::Validator blend_validator = [scene_monitor](const moveit_msgs::msg::RobotState &start,
+                                                                 const moveit_msgs::msg::RobotTrajectory &trajectory)
+  {
+    planning_scene_monitor::LockedPlanningSceneRO scene(scene_monitor);
+    return scene->isPathValid(start, trajectory);
+  };
+  std::shared_ptr<TrajectoryBlender> blender_1, blender_2;
+  if (blendSegments)
+  {
+    blender_1 = std::make_shared<TrajectoryBlender>(kinematic_model, "panda_1", 0.05, 0.5, 0.5);
+    blender_2 = std::make_shared<TrajectoryBlender>(kinematic_model, "panda_2", 0.05, 0.5, 0.5);
+    blender_1->setValidator(blend_validator);
+    blender_2->setValidator(blend_validator);
+  }
 
-      auto object_id = current_object.collisionObject.id;
-      RCLCPP_INFO(LOGGER, "Object: %s", object_id.c_str());
+  // full speed in transit, slow on the way down to the cube and into the
+  // tray slot
+  std::shared_ptr<TrajectoryRetimer> retimer_1, retimer_2;
+  if (retimeTrajectories)
+  {
+    retimer_1 = std::make_shared<TrajectoryRetimer>(kinematic_model, "panda_1");
+    retimer_2 = std::make_shared<TrajectoryRetimer>(kinematic_model, "panda_2");
+    for (TrajectoryRetimer *retimer : {retimer_1.get(), retimer_2.get()})
+    {
+      retimer->setScaling("grasp", StageScaling(0.25, 0.25));
+      retimer->setScaling("putdown", StageScaling(0.25, 0.25));
+      retimer->setValidator(blend_validator);
+    }
+  }
 
-      // Check if the object is a box
-      if (object_id.rfind("box", 0) != 0)
+  // the shortcuts are checked on a copy of the scene taken once per
+  // trajectory, so the parallel checks do not hold the scene lock
+  auto scene_check = [scene_monitor](const std::string &group)
+  {
+    return [scene_monitor, group]()
+    {
+      planning_scene::PlanningScenePtr scene;
       {
-        continue;
+        planning_scene_monitor::LockedPlanningSceneRO locked(scene_monitor);
+        scene = planning_scene::PlanningScene::clone(locked);
       }
+      const moveit::core::JointModelGroup *jmg = scene->getRobotModel()->getJointModelGroup(group);
+      return PathShortcutter::StateCheck([scene, jmg](const std::vector<double> &joint_values)
+                                         {
+        moveit::core::RobotState state(scene->getCurrentState());
+        state.setJointGroupPositions(jmg, joint_values);
+        state.update();
+        return !scene->isStateColliding(state, jmg->getName()); });
+    };
+  };
+
+  // timed like the move groups above
+  std::shared_ptr<TrajectoryShortcutter> shortcutter_1, shortcutter_2;
+  if (shortcutPaths)
+  {
+    shortcutter_1 = std::make_shared<TrajectoryShortcutter>(kinematic_model, "panda_1", 0.5, 0.5);
+    shortcutter_2 = std::make_shared<TrajectoryShortcutter>(kinematic_model, "panda_2", 0.5, 0.5);
+    shortcutter_1->setCheckFactory(scene_check("panda_1"));
+    shortcutter_2->setCheckFactory(scene_check("panda_2"));
+  }
 
-      bool panda_1_success = true;
-      
-      // plan for if the arm one is not busy
-      if (!panda_1_busy)
-      {
-        tray_helper *active_tray;
-        if (colors[object_id].color.r == 1 && colors[object_id].color.g == 0 && colors[object_id].color.b == 0)
-          active_tray = &red_tray_1;
-        else if (colors[object_id].color.r == 0 && colors[object_id].color.g == 0 && colors[object_id].color.b == 1)
-          active_tray = &blue_tray_1;
-        else
-          continue;
+  // the deterministic pilz PTP, two differently seeded RRTConnect runs and
+  // CHOMP; every variant opens its own move group interface, so they are
+  // only created when used
+  std::vector<PlannerVariant> variants{
+      PlannerVariant("pilz_industrial_motion_planner", "PTP"),
+      PlannerVariant("ompl", "RRTConnectkConfigDefault"),
+      PlannerVariant("ompl", "RRTConnectkConfigDefault"),
+      PlannerVariant("chomp", "")};
+  std::shared_ptr<SpeculativePlanner> speculative_1, speculative_2;
+  if (speculativePlanning)
+  {
+    speculative_1 = std::make_shared<SpeculativePlanner>(node, "panda_1", variants, 0.05, 0.5, 0.5, 1);
+    speculative_2 = std::make_shared<SpeculativePlanner>(node, "panda_2", variants, 0.05, 0.5, 0.5, 1);
+  }
 
-        panda_1_busy = true;
-
-        new std::thread([&]()
-                        {
-          
-          auto current_object_1 = std::move(current_object);
-          //bool panda_1_success = executeTrajectory(pnp_1, current_object_1.collisionObject,active_tray);
-          bool panda_1_success = advancedExecuteTrajectory(arm_1_state, panda_1_arm, kinematic_model, 
-          kinematic_state, current_object_1.collisionObject,active_tray, 1);
-          
-          if(!panda_1_success)
-          {
-            objs.push(current_object_1);
-          }else{
-            runner2.increment();
-            RCLCPP_INFO(LOGGER, "[checkpoint] Robot 1 successful placing. Request to spawn a new cube ");
-            
-            if(runner2.check() >= number_of_test_cases)
-              RCLCPP_INFO(LOGGER, "[terminate]");
-          
-            // auto message = std_msgs::msg::String();
-
-            // if(runner2.check() % 4 == 0){
-            //   for(int i = 0; i < 4; i++){
-            //     publisher_->publish(message);
-            //   }
-            // }
-            
-          }
-          panda_1_busy = false; });
+  // starts from the 1 s and 5 attempts set above
+  std::shared_ptr<PlanningBudget> planning_budget;
+  if (adaptiveBudget)
+  {
+    planning_budget = std::make_shared<PlanningBudget>();
+  }
 
-        //std::this_thread::sleep_for(3.s);
-        //r.sleep();
-      }
-      else if (!panda_2_busy)
+  // where the bounding boxes of the two arms overlap, the arms are checked
+  // against each other, with the cubes they hold, in the current scene
+  std::shared_ptr<ReservationTable> reservation_table;
+  if (reserveMotions)
+  {
+    reservation_table = std::make_shared<ReservationTable>(kinematic_model);
+    reservation_table->setExactCheck([scene_monitor](const std::vector<std::string> &names_1, const std::vector<double> &values_1,
+                                                     const std::vector<std::string> &names_2, const std::vector<double> &values_2)
+                                     {
+      planning_scene_monitor::LockedPlanningSceneRO scene(scene_monitor);
+      moveit::core::RobotState state(scene->getCurrentState());
+      state.setVariablePositions(names_1, values_1);
+      state.setVariablePositions(names_2, values_2);
+      state.update();
+      collision_detection::CollisionRequest request;
+      collision_detection::CollisionResult result;
+      scene->checkSelfCollision(request, result, state);
+      return result.collision; });
+    // the cubes in the grippers, as the scene has them attached now
+    reservation_table->setAttachedBodies([scene_monitor]()
+                                         {
+      std::vector<ReservationTable::AttachedSphere> spheres;
+      planning_scene_monitor::LockedPlanningSceneRO scene(scene_monitor);
+      std::vector<const moveit::core::AttachedBody *> bodies;
+      scene->getCurrentState().getAttachedBodies(bodies);
+      for (const moveit::core::AttachedBody *body : bodies)
       {
-        planned_for_panda_2 = false;
-        tray_helper *active_tray;
-        if (colors[object_id].color.r == 1 && colors[object_id].color.g == 0 && colors[object_id].color.b == 0)
-          active_tray = &red_tray_2;
-        else if (colors[object_id].color.r == 0 && colors[object_id].color.g == 0 && colors[object_id].color.b == 1)
-          active_tray = &blue_tray_2;
-        else
-          continue;
-
-        panda_2_busy = true;
-
-        new std::thread([&]()
-                        {
-          
-          auto current_object_2 = std::move(current_object);
-          //bool panda_1_success = executeTrajectory(pnp_1, current_object_1.collisionObject,active_tray);
-          bool panda_2_success = advancedExecuteTrajectory(arm_2_state, panda_2_arm, kinematic_model_2, 
-          kinematic_state_2, current_object_2.collisionObject, active_tray, 2);
-          
-          if(!panda_2_success)
-          {
-            objs.push(current_object_2);
-          }else{
-            runner2.increment();
-            RCLCPP_INFO(LOGGER, "[checkpoint] Robot 2 successful placing. Request to spawn a new cube ");
-            
-            if(runner2.check() >= number_of_test_cases)
-              RCLCPP_INFO(LOGGER, "[terminate]");
-          
-            // auto message = std_msgs::msg::String();
-            //publisher_->publish(message);
-          }
-          panda_2_busy = false; });
-        
-        //std::this_thread::sleep_for(3.s);
+        for (size_t i = 0; i < body->getShapes().size(); ++i)
+        {
+          ReservationTable::AttachedSphere sphere;
+          sphere.link = body->getAttachedLinkName();
+          sphere.center = body->getShapePosesInLinkFrame()[i].translation();
+          sphere.radius = shapes::computeShapeExtents(body->getShapes()[i].get()).norm() / 2;
+          spheres.push_back(sphere);
+        }
       }
-    }
-    std::this_thread::sleep_for(3.s);
+      return spheres; });
+  }
 
-    //r.sleep();
+  // every feature enabled above is one stage of an arm's planner or
+  // execution chain, see stage_planner.hpp and stage_execution.hpp
+  auto planner_chain = [&](moveit::planning_interface::MoveGroupInterface &planning, moveit::core::RobotStatePtr ik_state,
+                           std::shared_ptr<IkService> ik, std::shared_ptr<SpeculativePlanner> speculative,
+                           std::shared_ptr<TrajectoryShortcutter> shortcutter)
+  {
+    StagePlannerPtr planner;
+    if (speculative)
+      planner = std::make_shared<SpeculativeStagePlanner>(speculative);
+    else
+      planner = std::make_shared<MoveGroupPlanner>(planning);
+    if (planning_budget)
+      planner = std::make_shared<BudgetedPlanner>(planner, planning_budget);
+    if (shortcutter)
+      planner = std::make_shared<ShortcutPlanner>(planner, shortcutter);
+    planner = std::make_shared<StraightLinePlanner>(planner, planning, LOGGER);
+    planner = std::make_shared<IkPlanner>(planner, ik_state, ik, LOGGER);
+    if (trajectory_cache)
+      planner = std::make_shared<CachedPlanner>(planner, trajectory_cache);
+    return planner;
+  };
+  auto execution_chain = [&](moveit::planning_interface::MoveGroupInterface &execution, const moveit::core::JointModelGroup *jmg,
+                             std::shared_ptr<TrajectoryRetimer> retimer)
+  {
+    StageExecutionPtr chain = std::make_shared<MoveGroupExecution>(execution);
+    if (reservation_table)
+      chain = std::make_shared<ReservedExecution>(chain, reservation_table, jmg, execution, LOGGER);
+    if (retimer)
+      chain = std::make_shared<RetimedExecution>(chain, retimer);
+    return chain;
+  };
+
+  // plans the next stage of a cube while the current one is executing
+  StagePipeline pipeline_1(panda_1_planning, arm_1_state.arm_joint_model_group,
+                           planner_chain(panda_1_planning, kinematic_state, pnp_1->ik_solver(), speculative_1, shortcutter_1),
+                           execution_chain(panda_1_arm, arm_1_state.arm_joint_model_group, retimer_1), LOGGER, planAhead);
+  StagePipeline pipeline_2(panda_2_planning, arm_2_state.arm_joint_model_group,
+                           planner_chain(panda_2_planning, kinematic_state_2, pnp_2->ik_solver(), speculative_2, shortcutter_2),
+                           execution_chain(panda_2_arm, arm_2_state.arm_joint_model_group, retimer_2), LOGGER, planAhead);
+  pipeline_1.setBlender(blender_1);
+  pipeline_2.setBlender(blender_2);
+
+  // pairs of tasks in each other's way are planned for both arms at once
+  std::unique_ptr<moveit::planning_interface::MoveGroupInterface> dual_arm;
+  if (schedulingMode == "hybrid")
+  {
+    dual_arm.reset(new moveit::planning_interface::MoveGroupInterface(node, "dual_arm"));
+    dual_arm->setMaxVelocityScalingFactor(0.50);
+    dual_arm->setMaxAccelerationScalingFactor(0.50);
+    dual_arm->setNumPlanningAttempts(5);
+    dual_arm->setPlanningTime(1);
   }
+  Point3D arm_bases[2] = {Point3D(0, -0.5, 1), Point3D(0, 0.5, 1)};
+  // where each arm's current task takes it
+  WorkspaceBox active_workspace[2];
+  size_t independent_tasks = 0, coordinated_pairs = 0, deferred_tasks = 0;
+  // the cube each arm was last held back with, counted once
+  std::string deferred_cube[2];
+
+  // one worker thread per arm for the whole run; declared after the move
+  // groups and states the tasks use, so they are joined before those go away
+  ArmExecutor executors[2];
+  std::future<ArmTaskOutcome> outcomes[2];
+  // the cube of each arm's task in flight, handed back if the task throws
+  CollisionPlanningObject running[2];
+
+  // requeues failed cubes and counts placed ones once an arm reports back
+  auto collect = [&](size_t arm)
+  {
+    if (!outcomes[arm].valid())
+      return;
 
-  RCLCPP_INFO(LOGGER, "Execution completed");
-}
+    ArmTaskOutcome outcome{running[arm], false};
+    try
+    {
+      outcome = outcomes[arm].get();
+    }
+    catch (const std::exception &e)
+    {
+      RCLCPP_ERROR(LOGGER, "Robot %zu task failed: %s", arm + 1, e.what());
+    }
+    if (!outcome.success)
+    {
+      objs.push(outcome.cube);
+      return;
+    }
 
-bool advancedExecuteTrajectory(arm_state &arm_1_state, moveit::planning_interface::MoveGroupInterface &panda_1_arm,  
-  moveit::core::RobotModelConstPtr kinematic_model, moveit::core::RobotStatePtr kinematic_state, 
-  moveit_msgs::msg::CollisionObject &object, tray_helper *tray, int s)
-{
+    runner2.increment();
+    RCLCPP_INFO(LOGGER, "[checkpoint] Robot %zu successful placing. Request to spawn a new cube ", arm + 1);
 
-  RCLCPP_INFO(LOGGER, "Start execution of Object: %s", object.id.c_str());
-  geometry_msgs::msg::Pose pose;
+    if (runner2.check() >= number_of_test_cases)
+      RCLCPP_INFO(LOGGER, "[terminate]");
+  };
 
-  // Pre Grasp
-  arm_1_state.pose.position.x = object.pose.position.x;
-  arm_1_state.pose.position.y = object.pose.position.y;
-  arm_1_state.pose.position.z = object.pose.position.z + 0.25;
+  dispatcher.resetMetrics();
 
-  arm_1_state.pose.orientation.x = object.pose.orientation.w;
-  arm_1_state.pose.orientation.y = object.pose.orientation.z;
-  arm_1_state.pose.orientation.z = 0;
-  arm_1_state.pose.orientation.w = 0;
+  // cubes taken out of the queue for an arm but not dispatched yet, e.g.
+  // the other idle arm's match of an assignment; only the dispatch loop
+  // touches them
+  CollisionPlanningObject claimed[2];
 
-  bool executionSuccessful = false;
-
-  RCLCPP_INFO(LOGGER, "Set from ik done ");
-  
-  while (!executionSuccessful)
+  // picks the next cube of `arm` and the tray it goes to; an empty cube id
+  // if the arm's queue has nothing for it right now
+  auto next_task = [&](size_t arm, ArmTask &task)
   {
+    CollisionPlanningObject current_object;
+    size_t current_shard = arm;
+    std::string curren_planning_robot = arm == 0 ? "robot_1" : "robot_2";
 
-    bool a_bot_found_ik = kinematic_state->setFromIK(arm_1_state.arm_joint_model_group, arm_1_state.pose, 0.1);
-
-    RCLCPP_INFO(LOGGER, "Starting pregrasp execution ");
+    // end effector position of the robot available
+    Point3D e = arm_bases[arm];
 
-    if (a_bot_found_ik)
+    if (!claimed[arm].collisionObject.id.empty())
     {
-      kinematic_state->copyJointGroupPositions(arm_1_state.arm_joint_model_group, arm_1_state.arm_joint_values);
-      panda_1_arm.setJointValueTarget(arm_1_state.arm_joint_names, arm_1_state.arm_joint_values);
-      RCLCPP_INFO(LOGGER, "IK found for arm 1");
-    }else{
-      continue;
+      current_object = claimed[arm];
+      claimed[arm] = CollisionPlanningObject();
     }
-    
-    moveit::planning_interface::MoveGroupInterface::Plan my_plan;
-    if (a_bot_found_ik)
+    else if (distanceType == "assignment")
     {
-      bool success = (panda_1_arm.plan(my_plan) == moveit::core::MoveItErrorCode::SUCCESS);
-      if(success){
-        RCLCPP_INFO(LOGGER, "pregrasp planning successful");
+      // match every idle arm without a cube at once; the matches of the
+      // other arms wait in `claimed` for their turn
+      std::vector<ArmRequest> arms{
+          ArmRequest("robot_1", Point3D(0, -0.5, 1), current_shard == 0 || (!dispatcher.busy(0) && claimed[0].collisionObject.id.empty())),
+          ArmRequest("robot_2", Point3D(0, 0.5, 1), current_shard == 1 || (!dispatcher.busy(1) && claimed[1].collisionObject.id.empty()))};
+      if (assignmentCost != "cartesian")
+      {
+        arms[0].joint_values = panda_1_arm.getCurrentJointValues();
+        arms[1].joint_values = panda_2_arm.getCurrentJointValues();
       }
-      if (!success || my_plan.trajectory_.joint_trajectory.points.size() == 0)
+      std::vector<CollisionPlanningObject> matches = popAssignment(objs, arms, assignment_cost);
+      current_object = matches[current_shard];
+      for (size_t other = 0; other < 2; ++other)
       {
-        RCLCPP_INFO(LOGGER, "Plan did not succeed");
-        return false;
+        if (other != current_shard && arms[other].free)
+          claimed[other] = matches[other];
       }
-      executionSuccessful = panda_1_arm.execute(my_plan) == moveit::core::MoveItErrorCode::SUCCESS;
     }
-  }
+    else if (distanceType == "randomDistance")
+    {
+      current_object = objs.pop(current_shard, curren_planning_robot, "random", e);
+    }
+    else
+    {
+      current_object = objs.pop(current_shard, curren_planning_robot, "", e);
+    }
 
+    task.cube = current_object;
+    auto object_id = current_object.collisionObject.id;
+    RCLCPP_INFO(LOGGER, "Object: %s", object_id.c_str());
 
-  // Pre Grasp
-  arm_1_state.pose.position.z = object.pose.position.z + 0.1;
+    if (object_id.empty())
+    {
+      return false;
+    }
 
-  executionSuccessful = false;
-  
-  while (!executionSuccessful)
-  {
+    // Check if the object is a box
+    if (object_id.rfind("box", 0) != 0)
+    {
+      return false;
+    }
+
+    bool red = colors[object_id].color.r == 1 && colors[object_id].color.g == 0 && colors[object_id].color.b == 0;
+    bool blue = colors[object_id].color.r == 0 && colors[object_id].color.g == 0 && colors[object_id].color.b == 1;
+    if (!red && !blue)
+    {
+      return false;
+    }
 
-    bool a_bot_found_ik = kinematic_state->setFromIK(arm_1_state.arm_joint_model_group, arm_1_state.pose, 0.1);
+    if (arm == 0)
+      task.tray = red ? &red_tray_1 : &blue_tray_1;
+    else
+      task.tray = red ? &red_tray_2 : &blue_tray_2;
 
-    RCLCPP_INFO(LOGGER, "Starting grasp execution ");
+    const auto &position = current_object.collisionObject.pose.position;
+    task.workspace = task_workspace(arm_bases[arm], Point3D(position.x, position.y, position.z),
+                                    Point3D(task.tray->get_x(), task.tray->get_y(), 1));
+    return true;
+  };
 
-    if (a_bot_found_ik)
+  // hands the task to the arm's executor, the loop moves on right away
+  auto dispatch = [&](size_t arm, ArmTask task)
+  {
+    dispatcher.markBusy(arm);
+    RCLCPP_INFO(LOGGER, "[metric] Robot %zu idle time %.3f s", arm + 1, dispatcher.idleSeconds(arm));
+    active_workspace[arm] = task.workspace;
+    running[arm] = task.cube;
+    independent_tasks++;
+
+    // the task owns its cube and tray
+    if (arm == 0)
     {
-      kinematic_state->copyJointGroupPositions(arm_1_state.arm_joint_model_group, arm_1_state.arm_joint_values);
-      panda_1_arm.setJointValueTarget(arm_1_state.arm_joint_names, arm_1_state.arm_joint_values);
-      RCLCPP_INFO(LOGGER, "IK found for arm 1");
-    }else{
-      continue;
+      outcomes[0] = executors[0].submit([&, task]() mutable
+                                        {
+        //bool panda_1_success = executeTrajectory(pnp_1, task.cube.collisionObject, task.tray);
+        ArmIdleGuard idle(dispatcher, 0);
+        ArmTaskOutcome outcome{task.cube, false};
+        outcome.success = advancedExecuteTrajectory(pipeline_1, task.cube.collisionObject, task.tray, 1);
+        return outcome; });
     }
-    
-    moveit::planning_interface::MoveGroupInterface::Plan my_plan;
-    if (a_bot_found_ik)
+    else
     {
-      bool success = (panda_1_arm.plan(my_plan) == moveit::core::MoveItErrorCode::SUCCESS);
-      if(success){
-        RCLCPP_INFO(LOGGER, "grasp planning successful");
+      outcomes[1] = executors[1].submit([&, task]() mutable
+                                        {
+        ArmIdleGuard idle(dispatcher, 1);
+        ArmTaskOutcome outcome{task.cube, false};
+        outcome.success = advancedExecuteTrajectory(pipeline_2, task.cube.collisionObject, task.tray, 2);
+        return outcome; });
+    }
+  };
+
+  // both tasks in lockstep through dual_arm, on the first arm's executor;
+  // the second arm's outcome comes through a promise
+  auto dispatch_coordinated = [&](ArmTask task_1, ArmTask task_2)
+  {
+    dispatcher.markBusy(0);
+    dispatcher.markBusy(1);
+    RCLCPP_INFO(LOGGER, "[metric] Robot 1 idle time %.3f s", dispatcher.idleSeconds(0));
+    RCLCPP_INFO(LOGGER, "[metric] Robot 2 idle time %.3f s", dispatcher.idleSeconds(1));
+    active_workspace[0] = task_1.workspace;
+    active_workspace[1] = task_2.workspace;
+    running[0] = task_1.cube;
+    running[1] = task_2.cube;
+    coordinated_pairs++;
+
+    auto second = std::make_shared<std::promise<ArmTaskOutcome>>();
+    outcomes[1] = second->get_future();
+    outcomes[0] = executors[0].submit([&, task_1, task_2, second]() mutable
+                                      {
+      ArmIdleGuard idle_1(dispatcher, 0), idle_2(dispatcher, 1);
+      bool success = false;
+      try
+      {
+        success = coordinatedExecuteTrajectory(*dual_arm, task_1.cube.collisionObject, task_1.tray,
+                                               task_2.cube.collisionObject, task_2.tray);
+        // the arms moved outside the table, hold them where they are now
+        if (reserveMotions)
+        {
+          moveit::core::RobotStatePtr now = dual_arm->getCurrentState();
+          for (const auto *jmg : {arm_1_state.arm_joint_model_group, arm_2_state.arm_joint_model_group})
+          {
+            std::vector<double> positions;
+            now->copyJointGroupPositions(jmg, positions);
+            reservation_table->hold(jmg->getName(), jmg->getVariableNames(), positions);
+          }
+        }
       }
-      if (!success || my_plan.trajectory_.joint_trajectory.points.size() == 0)
+      catch (...)
       {
-        RCLCPP_INFO(LOGGER, "Plan did not succeed");
-        return false;
+        second->set_exception(std::current_exception());
+        throw;
       }
-      executionSuccessful = panda_1_arm.execute(my_plan) == moveit::core::MoveItErrorCode::SUCCESS;
-    }
-  }
-
-
-  // pre move
-  if(s == 1){
-    pnp_1->grasp_object(object);
-  }else if(s == 2){
-    pnp_2->grasp_object(object);
-  }
-
-  arm_1_state.pose.position.z = object.pose.position.z + 0.25;
+      second->set_value(ArmTaskOutcome{task_2.cube, success});
+      return ArmTaskOutcome{task_1.cube, success}; });
+  };
 
-  executionSuccessful = false;
-  
-  while (!executionSuccessful)
+  // idle arms whose last pick came back empty
+  unsigned empty_arms = 0;
+  while (true)
   {
+    for (size_t arm = 0; arm < 2; ++arm)
+    {
+      if (!dispatcher.busy(arm))
+        collect(arm);
+    }
 
-    bool a_bot_found_ik = kinematic_state->setFromIK(arm_1_state.arm_joint_model_group, arm_1_state.pose, 0.1);
+    if (runner2.check() >= number_of_test_cases)
+      break;
 
-    RCLCPP_INFO(LOGGER, "Starting premove execution ");
+    // sleep until an arm is free and there are cubes; finishing arms and
+    // newly detected cubes wake us up immediately
+    int arm = dispatcher.waitForIdleArm([&]()
+                                        { return !objs.empty() || !claimed[0].collisionObject.id.empty() ||
+                                                 !claimed[1].collisionObject.id.empty(); },
+                                        1000ms);
+    if (arm < 0)
+    {
+      continue;
+    }
+    collect(arm);
 
-    if (a_bot_found_ik)
+    ArmTask task;
+    if (!next_task(arm, task))
     {
-      kinematic_state->copyJointGroupPositions(arm_1_state.arm_joint_model_group, arm_1_state.arm_joint_values);
-      panda_1_arm.setJointValueTarget(arm_1_state.arm_joint_names, arm_1_state.arm_joint_values);
-      RCLCPP_INFO(LOGGER, "IK found for arm 1");
-    }else{
+      // nothing this arm may take right now; the idle arms take turns, so
+      // only wait for the state to change once every one of them came back
+      // empty
+      if (task.cube.collisionObject.id.empty())
+      {
+        empty_arms |= 1u << arm;
+        bool all_empty = true;
+        for (size_t other = 0; other < 2; ++other)
+        {
+          all_empty = all_empty && (dispatcher.busy(other) || (empty_arms & (1u << other)));
+        }
+        if (all_empty)
+        {
+          empty_arms = 0;
+          dispatcher.waitForEvent(1000ms);
+        }
+      }
       continue;
     }
-    
-    moveit::planning_interface::MoveGroupInterface::Plan my_plan;
-    if (a_bot_found_ik)
+    empty_arms = 0;
+
+    if (schedulingMode == "hybrid")
     {
-      bool success = (panda_1_arm.plan(my_plan) == moveit::core::MoveItErrorCode::SUCCESS);
-      if(success){
-        RCLCPP_INFO(LOGGER, "premove planning successful");
+      size_t other = 1 - arm;
+      if (dispatcher.busy(other))
+      {
+        // the other arm is working where this one would go; keep the cube
+        // for this arm, out of the queue so it is not picked again as a
+        // new attempt, and dispatch the two together once the other is done
+        if (task.workspace.overlaps(active_workspace[other]))
+        {
+          claimed[arm] = task.cube;
+          if (deferred_cube[arm] != task.cube.collisionObject.id)
+            deferred_tasks++;
+          deferred_cube[arm] = task.cube.collisionObject.id;
+          dispatcher.waitForEvent(1000ms);
+          continue;
+        }
       }
-      if (!success || my_plan.trajectory_.joint_trajectory.points.size() == 0)
+      else
       {
-        RCLCPP_INFO(LOGGER, "Plan did not succeed");
-        continue;
+        collect(other);
+        ArmTask other_task;
+        if (next_task(other, other_task))
+        {
+          if (task.workspace.overlaps(other_task.workspace))
+          {
+            if (arm == 0)
+              dispatch_coordinated(task, other_task);
+            else
+              dispatch_coordinated(other_task, task);
+            continue;
+          }
+          dispatch(other, other_task);
+        }
       }
-      executionSuccessful = panda_1_arm.execute(my_plan) == moveit::core::MoveItErrorCode::SUCCESS;
     }
-  }
 
-  // Move
-  arm_1_state.pose.position.x = tray->get_x();
-  arm_1_state.pose.position.y = tray->get_y();
-  arm_1_state.pose.position.z = 1.28 + tray->z * 0.05;
+    dispatch(arm, task);
+  }
 
-  arm_1_state.pose.orientation.x = 1;
-  arm_1_state.pose.orientation.y = 0;
+  // the arm tasks use the move groups above, let them finish first
+  dispatcher.waitAllIdle();
+  collect(0);
+  collect(1);
 
-  executionSuccessful = false;
-  
-  while (!executionSuccessful)
+  RCLCPP_INFO(LOGGER, "[metric] Robot 1 total idle time %.3f s over %zu tasks", dispatcher.idleSeconds(0), dispatcher.dispatched(0));
+  RCLCPP_INFO(LOGGER, "[metric] Robot 2 total idle time %.3f s over %zu tasks", dispatcher.idleSeconds(1), dispatcher.dispatched(1));
+  if (schedulingMode == "hybrid")
   {
+    RCLCPP_INFO(LOGGER, "[metric] Hybrid scheduling: %zu independent tasks, %zu coordinated pairs, %zu tasks held back for the other arm",
+                independent_tasks, coordinated_pairs, deferred_tasks);
+  }
 
-    bool a_bot_found_ik = kinematic_state->setFromIK(arm_1_state.arm_joint_model_group, arm_1_state.pose, 0.1);
-
-    RCLCPP_INFO(LOGGER, "Starting premove execution ");
-
-    if (a_bot_found_ik)
+  if (cacheTrajectories)
+  {
+    TrajectoryCache::Stats cache_stats = trajectory_cache->statistics();
+    RCLCPP_INFO(LOGGER, "[metric] Trajectory cache: %zu hits, %zu misses (%zu rejected by the scene), %.3f s planning saved",
+                cache_stats.hits, cache_stats.misses, cache_stats.rejected, cache_stats.planning_time_saved);
+  }
+  if (blendSegments)
+  {
+    TrajectoryBlender::Stats blend_stats[2] = {blender_1->statistics(), blender_2->statistics()};
+    for (size_t arm = 0; arm < 2; ++arm)
     {
-      kinematic_state->copyJointGroupPositions(arm_1_state.arm_joint_model_group, arm_1_state.arm_joint_values);
-      panda_1_arm.setJointValueTarget(arm_1_state.arm_joint_names, arm_1_state.arm_joint_values);
-      RCLCPP_INFO(LOGGER, "IK found for arm 1");
-    }else{
-      continue;
+      RCLCPP_INFO(LOGGER, "[metric] Robot %zu blending: %zu blended, %zu joined without blending, %zu failed, %.3f s of motion instead of %.3f s",
+                  arm + 1, blend_stats[arm].blended, blend_stats[arm].unblended, blend_stats[arm].failed,
+                  blend_stats[arm].blended_time, blend_stats[arm].segment_time);
     }
-    
-    moveit::planning_interface::MoveGroupInterface::Plan my_plan;
-    if (a_bot_found_ik)
+  }
+  if (retimeTrajectories)
+  {
+    TrajectoryRetimer *retimers[2] = {retimer_1.get(), retimer_2.get()};
+    for (size_t arm = 0; arm < 2; ++arm)
     {
-      bool success = (panda_1_arm.plan(my_plan) == moveit::core::MoveItErrorCode::SUCCESS);
-      if(success){
-        RCLCPP_INFO(LOGGER, "premove planning successful");
-      }
-      if (!success || my_plan.trajectory_.joint_trajectory.points.size() == 0)
+      for (const auto &stage : retimers[arm]->statistics())
       {
-        RCLCPP_INFO(LOGGER, "Plan did not succeed");
-        continue;
+        RCLCPP_INFO(LOGGER, "[metric] Robot %zu retiming %s: %zu retimed, %zu kept, %.3f s of motion instead of %.3f s, %.3f s saved",
+                    arm + 1, stage.first.c_str(), stage.second.retimed, stage.second.kept, stage.second.retimed_time,
+                    stage.second.planned_time, stage.second.planned_time - stage.second.retimed_time);
       }
-      executionSuccessful = panda_1_arm.execute(my_plan) == moveit::core::MoveItErrorCode::SUCCESS;
     }
   }
-  // Put down
-  arm_1_state.pose.position.z = 1.141 + tray->z * 0.05;
-
-  executionSuccessful = false;
-  
-  while (!executionSuccessful)
+  if (shortcutPaths)
   {
-
-    bool a_bot_found_ik = kinematic_state->setFromIK(arm_1_state.arm_joint_model_group, arm_1_state.pose, 0.1);
-
-    RCLCPP_INFO(LOGGER, "Starting premove execution ");
-
-    if (a_bot_found_ik)
+    TrajectoryShortcutter::Stats shortcut_stats[2] = {shortcutter_1->statistics(), shortcutter_2->statistics()};
+    int cubes = std::max(1, runner2.check());
+    for (size_t arm = 0; arm < 2; ++arm)
     {
-      kinematic_state->copyJointGroupPositions(arm_1_state.arm_joint_model_group, arm_1_state.arm_joint_values);
-      panda_1_arm.setJointValueTarget(arm_1_state.arm_joint_names, arm_1_state.arm_joint_values);
-      RCLCPP_INFO(LOGGER, "IK found for arm 1");
-    }else{
-      continue;
+      const TrajectoryShortcutter::Stats &s = shortcut_stats[arm];
+      RCLCPP_INFO(LOGGER, "[metric] Robot %zu shortcutting: %zu paths, %zu shortcuts, %zu smoothed, length %.3f -> %.3f rad, "
+                          "motion %.3f -> %.3f s, %.3f s spent",
+                  arm + 1, s.processed, s.shortcuts, s.smoothed, s.length_before, s.length_after, s.duration_before,
+                  s.duration_after, s.processing_time);
     }
-    
-    moveit::planning_interface::MoveGroupInterface::Plan my_plan;
-    if (a_bot_found_ik)
+    RCLCPP_INFO(LOGGER, "[metric] Shortcutting saved %.3f s of motion per cube",
+                (shortcut_stats[0].duration_before - shortcut_stats[0].duration_after + shortcut_stats[1].duration_before -
+                 shortcut_stats[1].duration_after) / cubes);
+  }
+  if (speculativePlanning)
+  {
+    RCLCPP_INFO(LOGGER, "[metric] Robot 1 speculative planning: %s", speculative_1->summary().c_str());
+    RCLCPP_INFO(LOGGER, "[metric] Robot 2 speculative planning: %s", speculative_2->summary().c_str());
+  }
+  if (reserveMotions)
+  {
+    ReservationTable::Stats reservation_stats = reservation_table->statistics();
+    RCLCPP_INFO(LOGGER, "[metric] Reservations: %zu motions, %zu delayed by %.3f s in total, %zu without a conflict free start planned again, %zu exact checks",
+                reservation_stats.reservations, reservation_stats.delayed, reservation_stats.delay, reservation_stats.unresolved,
+                reservation_stats.exact_checks);
+  }
+  if (adaptiveBudget)
+  {
+    for (const std::string &line : planning_budget->summary())
     {
-      bool success = (panda_1_arm.plan(my_plan) == moveit::core::MoveItErrorCode::SUCCESS);
-      if(success){
-        RCLCPP_INFO(LOGGER, "premove planning successful");
-      }
-      if (!success || my_plan.trajectory_.joint_trajectory.points.size() == 0)
-      {
-        RCLCPP_INFO(LOGGER, "Plan did not succeed");
-        continue;
-      }
-      executionSuccessful = panda_1_arm.execute(my_plan) == moveit::core::MoveItErrorCode::SUCCESS;
+      RCLCPP_INFO(LOGGER, "[metric] Planning budget %s", line.c_str());
     }
   }
+  RCLCPP_INFO(LOGGER, "[metric] Robot 1 IK: %s", pnp_1->ik_solver()->summary().c_str());
+  RCLCPP_INFO(LOGGER, "[metric] Robot 2 IK: %s", pnp_2->ik_solver()->summary().c_str());
 
-  if(s == 1){
-    pnp_1->release_object(object);
-  }else if(s == 2){
-    pnp_2->release_object(object);
-  }
-  // Post Move
-  arm_1_state.pose.position.z = 1.28 + tray->z * 0.05;
+  RCLCPP_INFO(LOGGER, "Execution completed");
+}
 
-  executionSuccessful = false;
-  
-  while (!executionSuccessful)
+bool advancedExecuteTrajectory(StagePipeline &pipeline, moveit_msgs::msg::CollisionObject &object, tray_helper *tray, int s)
+{
+  RCLCPP_INFO(LOGGER, "Start execution of Object: %s", object.id.c_str());
+
+  std::shared_ptr<primitive_pick_and_place> pnp = s == 1 ? pnp_1 : pnp_2;
+
+  // above the tray slot, pointing down
+  auto tray_pose = [tray](double height)
+  {
+    geometry_msgs::msg::Pose pose;
+    pose.position.x = tray->get_x();
+    pose.position.y = tray->get_y();
+    pose.position.z = height + tray->z * 0.05;
+    pose.orientation.x = 1;
+    pose.orientation.y = 0;
+    pose.orientation.z = 0;
+    pose.orientation.w = 0;
+    return pose;
+  };
+
+  // tray slot and stage, the slots repeat on every layer of cubes
+  auto slot_goal = [tray, s](const std::string &stage)
+  {
+    char id[96];
+    snprintf(id, sizeof(id), "%d/%s/%.3f/%.3f/%d", s, stage.c_str(), tray->get_x(), tray->get_y(), tray->z);
+    return std::string(id);
+  };
+
+  // the cube has not been touched before the grasp, so give it back instead
+  // of retrying an unreachable pose forever; once it is in the gripper,
+  // keep trying
+  StageRetryPolicy untouched(max_ik_attempts, 1);
+
+  // the grasp yaw is picked once per cube and kept down to the cube and
+  // back up, the tray yaw once for the three tray stages
+  auto grasp_choice = std::make_shared<int>(-1);
+  auto place_choice = std::make_shared<int>(-1);
+  auto grasp = [&object, grasp_choice](double height)
+  {
+    return SymmetricTarget{[&object, height]()
+                           { return box_grasps(object, height); }, grasp_choice};
+  };
+  auto place = [tray_pose, place_choice](double height)
   {
+    return SymmetricTarget{[tray_pose, height]()
+                           { return place_candidates(tray_pose(height)); }, place_choice};
+  };
+
+  std::vector<PipelineStage> stages{
+      PipelineStage("pregrasp", grasp(0.25), untouched),
+      PipelineStage("grasp", grasp(0.1), untouched),
+      PipelineStage("premove", grasp(0.25), StageRetryPolicy(), [pnp, &object]()
+                    { pnp->grasp_object(object); }),
+      PipelineStage("move", place(1.28), StageRetryPolicy(), nullptr, [slot_goal]()
+                    { return slot_goal("move"); }),
+      PipelineStage("putdown", place(1.141), StageRetryPolicy(), nullptr, [slot_goal]()
+                    { return slot_goal("putdown"); }),
+      PipelineStage("postmove", place(1.28), StageRetryPolicy(), [pnp, &object]()
+                    { pnp->release_object(object); }, [slot_goal]()
+                    { return slot_goal("postmove"); })};
+
+  if (!pipeline.run(stages))
+  {
+    return false;
+  }
 
-    bool a_bot_found_ik = kinematic_state->setFromIK(arm_1_state.arm_joint_model_group, arm_1_state.pose, 0.1);
+  tray->next();
 
-    RCLCPP_INFO(LOGGER, "Starting premove execution ");
+  return true;
+}
 
-    if (a_bot_found_ik)
-    {
-      kinematic_state->copyJointGroupPositions(arm_1_state.arm_joint_model_group, arm_1_state.arm_joint_values);
-      panda_1_arm.setJointValueTarget(arm_1_state.arm_joint_names, arm_1_state.arm_joint_values);
-      RCLCPP_INFO(LOGGER, "IK found for arm 1");
-    }else{
-      continue;
-    }
-    
-    moveit::planning_interface::MoveGroupInterface::Plan my_plan;
-    if (a_bot_found_ik)
+// Both arms' pick and places in lockstep, every stage planned for the two
+// arms at once in dual_arm as in benchmark_synchronous. Used for pairs of
+// tasks whose workspaces overlap, where the dual_arm planner keeps the arms
+// apart.
+bool coordinatedExecuteTrajectory(moveit::planning_interface::MoveGroupInterface &dual_arm, moveit_msgs::msg::CollisionObject &object_1,
+                                  tray_helper *tray_1, moveit_msgs::msg::CollisionObject &object_2, tray_helper *tray_2)
+{
+  RCLCPP_INFO(LOGGER, "Start coordinated execution of Objects: %s %s", object_1.id.c_str(), object_2.id.c_str());
+
+  std::shared_ptr<primitive_pick_and_place> pnps[2] = {pnp_1, pnp_2};
+  moveit_msgs::msg::CollisionObject *objects[2] = {&object_1, &object_2};
+  tray_helper *trays[2] = {tray_1, tray_2};
+  moveit::core::RobotModelConstPtr model = dual_arm.getRobotModel();
+  const moveit::core::JointModelGroup *jmgs[2] = {model->getJointModelGroup("panda_1"), model->getJointModelGroup("panda_2")};
+
+  typedef std::function<std::vector<geometry_msgs::msg::Pose>(int)> Candidates;
+
+  // above the arm's tray slot, pointing down
+  auto tray_pose = [&trays](int i, double height)
+  {
+    geometry_msgs::msg::Pose pose;
+    pose.position.x = trays[i]->get_x();
+    pose.position.y = trays[i]->get_y();
+    pose.position.z = height + trays[i]->z * 0.05;
+    pose.orientation.x = 1;
+    pose.orientation.y = 0;
+    pose.orientation.z = 0;
+    pose.orientation.w = 0;
+    return pose;
+  };
+  auto grasp = [&objects](double height)
+  {
+    return Candidates([&objects, height](int i)
+                      { return box_grasps(*objects[i], height); });
+  };
+  auto place = [tray_pose](double height)
+  {
+    return Candidates([tray_pose, height](int i)
+                      { return place_candidates(tray_pose(i, height)); });
+  };
+
+  // every arm takes its reachable candidate closest to where it is, then
+  // both move; `attempts` of 0 retries until it works
+  auto stage = [&](const Candidates &candidates, int attempts)
+  {
+    for (int attempt = 0; attempts <= 0 || attempt < attempts; ++attempt)
     {
-      bool success = (panda_1_arm.plan(my_plan) == moveit::core::MoveItErrorCode::SUCCESS);
-      if(success){
-        RCLCPP_INFO(LOGGER, "premove planning successful");
-      }
-      if (!success || my_plan.trajectory_.joint_trajectory.points.size() == 0)
+      moveit::core::RobotStatePtr current = dual_arm.getCurrentState();
+      bool found = true;
+      for (int i = 0; i < 2 && found; ++i)
       {
-        RCLCPP_INFO(LOGGER, "Plan did not succeed");
-        continue;
+        std::vector<double> seed;
+        current->copyJointGroupPositions(jmgs[i], seed);
+        GraspIk ik = [&](const geometry_msgs::msg::Pose &pose, std::vector<double> &joint_values)
+        { return pnps[i]->ik_solver()->solve(pose, joint_values, &seed); };
+
+        GraspChoice choice;
+        found = select_grasp(candidates(i), seed, ik, choice);
+        if (found)
+          dual_arm.setJointValueTarget(jmgs[i]->getVariableNames(), choice.joint_values);
       }
-      executionSuccessful = panda_1_arm.execute(my_plan) == moveit::core::MoveItErrorCode::SUCCESS;
+      if (found && dual_arm.move() == moveit::core::MoveItErrorCode::SUCCESS)
+        return true;
+      RCLCPP_INFO(LOGGER, "Try again coordinated stage failed");
     }
+    return false;
+  };
+
+  // the cubes go back to the queue as long as they are not grasped
+  if (!stage(grasp(0.25), max_ik_attempts) || !stage(grasp(0.1), max_ik_attempts))
+  {
+    return false;
   }
-  //if()
-  //pnp_1->open_gripper();
-  tray->next();
+
+  pnp_1->grasp_object(object_1);
+  pnp_2->grasp_object(object_2);
+
+  stage(grasp(0.25), 0);
+  stage(place(1.28), 0);
+  stage(place(1.141), 0);
+
+  pnp_1->release_object(object_1);
+  pnp_2->release_object(object_2);
+
+  stage(place(1.28), 0);
+
+  tray_1->next();
+  tray_2->next();
 
   return true;
 }
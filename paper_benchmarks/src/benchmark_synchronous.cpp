@@ -1,6 +1,8 @@
 #include "paper_benchmarks/benchmark_synchronous.hpp"
 #include "paper_benchmarks/cube_selector.hpp"
+#include "paper_benchmarks/grasp_candidates.hpp"
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>
+#include <future>
 
 using namespace std::chrono_literals;
 
@@ -27,9 +29,25 @@ int main(int argc, char **argv)
 
   node = std::make_shared<rclcpp::Node>("benchmark_baseline");
 
+  node->declare_parameter("launchType", "euclideanDistance");
+  node->declare_parameter("reachabilityMapDirectory", "");
   node->declare_parameter("cubesToPick", 5);
+  node->declare_parameter("blendSegments", false);
+  node->declare_parameter("planningMode", "joint");
+  node->declare_parameter("pipelineExecution", false);
 
+  distanceType = node->get_parameter("launchType").as_string();
   number_of_test_cases = node->get_parameter("cubesToPick").as_int();
+  blendSegments = node->get_parameter("blendSegments").as_bool();
+  planningMode = node->get_parameter("planningMode").as_string();
+  pipelineExecution = node->get_parameter("pipelineExecution").as_bool();
+
+  RCLCPP_INFO(LOGGER, "launch: %s", distanceType.c_str());
+  RCLCPP_INFO(LOGGER, "blend segments: %s", blendSegments ? "true" : "false");
+  RCLCPP_INFO(LOGGER, "planning mode: %s", planningMode.c_str());
+  RCLCPP_INFO(LOGGER, "pipeline execution: %s", pipelineExecution ? "true" : "false");
+
+  load_reachability_maps(objs, node->get_parameter("reachabilityMapDirectory").as_string(), LOGGER);
 
   pnp_1 = std::make_shared<primitive_pick_and_place>(node, "panda_1");
   pnp_2 = std::make_shared<primitive_pick_and_place>(node, "panda_2");
@@ -108,6 +126,52 @@ void main_thread()
       arm_state(kinematic_model->getJointModelGroup("panda_1")),
       arm_state(kinematic_model->getJointModelGroup("panda_2")));
 
+  // joined motions round their corners and decoupled plans merge two paths,
+  // both checked against the scene before they are used; without either the
+  // monitor is not started, so the baseline runs as before
+  planning_scene_monitor::PlanningSceneMonitorPtr scene_monitor;
+  if (blendSegments || planningMode == "decoupled")
+  {
+    scene_monitor = std::make_shared<planning_scene_monitor::PlanningSceneMonitor>(node, "robot_description");
+    scene_monitor->startSceneMonitor();
+    scene_monitor->startStateMonitor();
+    scene_monitor->requestPlanningSceneState();
+  }
+
+  TrajectoryBlender blender(kinematic_model, "dual_arm", 0.05, 0.5, 0.5);
+  blender.setValidator([scene_monitor](const moveit_msgs::msg::RobotState &start, const moveit_msgs::msg::RobotTrajectory &trajectory)
+                       {
+    planning_scene_monitor::LockedPlanningSceneRO scene(scene_monitor);
+    return scene->isPathValid(start, trajectory); });
+  std::vector<moveit::planning_interface::MoveGroupInterface::Plan> segments;
+
+  // panda_1 first, panda_2 around it, merged paths checked in the scene
+  DecoupledPlanner decoupled(panda_1_arm, panda_2_arm, "dual_arm", 0.5, 0.5);
+  decoupled.setValidator([scene_monitor](const moveit_msgs::msg::RobotState &start, const moveit_msgs::msg::RobotTrajectory &trajectory)
+                         {
+    planning_scene_monitor::LockedPlanningSceneRO scene(scene_monitor);
+    return scene->isPathValid(start, trajectory, "dual_arm"); });
+  if (planningMode == "decoupled")
+  {
+    panda_1_arm.setNumPlanningAttempts(5);
+    panda_1_arm.setPlanningTime(1);
+    panda_2_arm.setNumPlanningAttempts(5);
+    panda_2_arm.setPlanningTime(1);
+    decoupled_planner = &decoupled;
+  }
+  auto *deferred = blendSegments ? &segments : nullptr;
+
+  // joined motions are already planned ahead as a whole; the motions run
+  // on their own interface while dual_arm plans the next one
+  std::unique_ptr<moveit::planning_interface::MoveGroupInterface> dual_arm_execution;
+  std::unique_ptr<MotionPipeline> motion_pipeline;
+  if (pipelineExecution && !blendSegments)
+  {
+    dual_arm_execution.reset(new moveit::planning_interface::MoveGroupInterface(node, "dual_arm"));
+    motion_pipeline.reset(new MotionPipeline(dual_arm, *dual_arm_execution));
+  }
+  MotionPipeline *pipeline = motion_pipeline.get();
+
   RCLCPP_INFO(LOGGER, "[Go to go]");
 
   srand(time(0));
@@ -134,21 +198,37 @@ void main_thread()
   {
     RCLCPP_INFO(LOGGER, "[starting pick and place]");
 
-    //arm_system.arm_1.object = objs.pop("", "random");
-    //arm_system.arm_2.object = objs.pop("", "random");
-
-    e.x = 0;
-    e.y = -0.5;
-    e.z = 1;
+    if (distanceType == "assignment")
+    {
+      // match both arms to cubes at once instead of letting arm 1 choose first
+      std::vector<ArmRequest> arms{
+          ArmRequest("robot_1", Point3D(0, -0.5, 1)),
+          ArmRequest("robot_2", Point3D(0, 0.5, 1))};
+      auto cubes = popAssignment(objs, arms, assignment_cost::cartesian());
+      arm_system.arm_1.object = cubes[0];
+      arm_system.arm_2.object = cubes[1];
+    }
+    else if (distanceType == "randomDistance")
+    {
+      arm_system.arm_1.object = objs.pop("", "random");
+      arm_system.arm_2.object = objs.pop("", "random");
+    }
+    else
+    {
+      arm_system.arm_1.object = objs.pop("robot_1", "", Point3D(0, -0.5, 1));
+      arm_system.arm_2.object = objs.pop("robot_2", "", Point3D(0, 0.5, 1));
+    }
 
-    objs.updatePoint(e);
-    arm_system.arm_1.object = objs.pop("robot_1", "");
-    
-    e.x = 0;
-    e.y = 0.5;
-    e.z = 1;  
-    objs.updatePoint(e);
-    arm_system.arm_2.object = objs.pop("robot_2", "");
+    // both arms need a cube; hand back a lone one and wait for more
+    if (arm_system.arm_1.object.collisionObject.id.empty() || arm_system.arm_2.object.collisionObject.id.empty())
+    {
+      if (!arm_system.arm_1.object.collisionObject.id.empty())
+        objs.push(arm_system.arm_1.object);
+      if (!arm_system.arm_2.object.collisionObject.id.empty())
+        objs.push(arm_system.arm_2.object);
+      std::this_thread::sleep_for(1.0s);
+      continue;
+    }
 
 
     RCLCPP_INFO(LOGGER, "[object id %s ]", arm_system.arm_1.object.collisionObject.id.c_str());
@@ -176,8 +256,9 @@ void main_thread()
       continue;
     
     
+    segments.clear();
     bool success = plan_and_move(arm_system, Movement::PREGRASP, kinematic_state, 1, dual_arm,
-                                 active_tray_arm_1, active_tray_arm_2);
+                                 active_tray_arm_1, active_tray_arm_2, deferred, pipeline);
     if (!success)
     {
       continue;
@@ -187,12 +268,27 @@ void main_thread()
     // pnp_2->open_gripper();
 
     success = plan_and_move(arm_system, Movement::GRASP, kinematic_state, 1, dual_arm,
-                            active_tray_arm_1, active_tray_arm_2);
+                            active_tray_arm_1, active_tray_arm_2, deferred, pipeline);
     if (!success)
     {
       continue;
     }
 
+    // the gripper closes on the cube only once the arms are there
+    if (pipeline && !pipeline->wait())
+    {
+      objs.push(arm_system.arm_1.object);
+      objs.push(arm_system.arm_2.object);
+      continue;
+    }
+
+    if (blendSegments && !execute_deferred(dual_arm, blender, segments))
+    {
+      objs.push(arm_system.arm_1.object);
+      objs.push(arm_system.arm_2.object);
+      continue;
+    }
+
     // from here onwards we cannot fail since the object is attached
 
     pnp_1->grasp_object(arm_system.arm_1.object.collisionObject);
@@ -202,19 +298,25 @@ void main_thread()
     auto cache_2 = active_tray_arm_2->z * 0.05;
 
     plan_and_move(arm_system, Movement::PREMOVE, kinematic_state, 1, dual_arm,
-                  active_tray_arm_1, active_tray_arm_2);
+                  active_tray_arm_1, active_tray_arm_2, deferred, pipeline);
 
     plan_and_move(arm_system, Movement::MOVE, kinematic_state, 1, dual_arm,
-                  active_tray_arm_1, active_tray_arm_2);
+                  active_tray_arm_1, active_tray_arm_2, deferred, pipeline);
 
     plan_and_move(arm_system, Movement::PUTDOWN, kinematic_state, 1, dual_arm,
-                  active_tray_arm_1, active_tray_arm_2);
+                  active_tray_arm_1, active_tray_arm_2, deferred, pipeline);
+
+    if ((blendSegments && !execute_deferred(dual_arm, blender, segments)) || (pipeline && !pipeline->wait()))
+    {
+      RCLCPP_ERROR(LOGGER, "Move to the trays failed");
+    }
 
     pnp_1->release_object(arm_system.arm_1.object.collisionObject);
     pnp_2->release_object(arm_system.arm_2.object.collisionObject);
 
+    // the next pair's pregrasp is planned while this one executes
     plan_and_move(arm_system, Movement::POSTMOVE, kinematic_state, 1, dual_arm,
-                  active_tray_arm_1, active_tray_arm_2);
+                  active_tray_arm_1, active_tray_arm_2, nullptr, pipeline);
 
     // spawn two new cubes
     auto message = std_msgs::msg::String();
@@ -232,11 +334,149 @@ void main_thread()
     //std::this_thread::sleep_for(1.0s);
     //publisher_->publish(message);
   }
+
+  if (pipeline)
+  {
+    pipeline->wait();
+    MotionPipeline::Stats pipeline_stats = pipeline->statistics();
+    RCLCPP_INFO(LOGGER, "[metric] Pipeline execution: %zu motions, %zu replanned, %zu failed, %.3f s planned while moving, %.3f s waiting for motions",
+                pipeline_stats.motions, pipeline_stats.replanned, pipeline_stats.failed, pipeline_stats.overlapped_time,
+                pipeline_stats.waiting_time);
+  }
+  if (decoupled_planner)
+  {
+    DecoupledPlanner::Stats decoupled_stats = decoupled.statistics();
+    RCLCPP_INFO(LOGGER, "[metric] Decoupled planning: %zu of %zu planned in %.3f s, %zu with panda_2 delayed by %.3f s in total",
+                decoupled_stats.planned, decoupled_stats.requests, decoupled_stats.planning_time, decoupled_stats.delayed,
+                decoupled_stats.delay);
+  }
+  if (blendSegments)
+  {
+    TrajectoryBlender::Stats blend_stats = blender.statistics();
+    RCLCPP_INFO(LOGGER, "[metric] Blending: %zu blended, %zu joined without blending, %zu failed, %.3f s of motion instead of %.3f s",
+                blend_stats.blended, blend_stats.unblended, blend_stats.failed, blend_stats.blended_time, blend_stats.segment_time);
+  }
+}
+
+// IK for both arms at once, each through its own parallel, cached solver.
+// The solution closest to the arm's joints in kinematic_state wins. Both
+// are written back to kinematic_state afterwards, since one RobotState
+// cannot be written from two threads.
+static void solve_ik_pair(moveit::core::RobotStatePtr kinematic_state, dual_arm_state &arm_system, bool &a_found, bool &b_found)
+{
+  std::vector<double> seed_1, seed_2;
+  kinematic_state->copyJointGroupPositions(arm_system.arm_1.arm_joint_model_group, seed_1);
+  kinematic_state->copyJointGroupPositions(arm_system.arm_2.arm_joint_model_group, seed_2);
+
+  auto arm_2 = std::async(std::launch::async, [&]()
+                          { return pnp_2->ik_solver()->solve(arm_system.arm_2.pose, arm_system.arm_2.arm_joint_values, &seed_2); });
+  a_found = pnp_1->ik_solver()->solve(arm_system.arm_1.pose, arm_system.arm_1.arm_joint_values, &seed_1);
+  b_found = arm_2.get();
+
+  if (a_found)
+  {
+    kinematic_state->setJointGroupPositions(arm_system.arm_1.arm_joint_model_group, arm_system.arm_1.arm_joint_values);
+  }
+  if (b_found)
+  {
+    kinematic_state->setJointGroupPositions(arm_system.arm_2.arm_joint_model_group, arm_system.arm_2.arm_joint_values);
+  }
+}
+
+// Sets arm.pose to the candidate whose IK solution is closest to the arm's
+// joints in kinematic_state. The first candidate stays if none is reachable,
+// the IK below then fails the usual way.
+static void choose_pose(std::shared_ptr<primitive_pick_and_place> pnp, moveit::core::RobotStatePtr kinematic_state, arm_state &arm,
+                        const std::vector<geometry_msgs::msg::Pose> &candidates)
+{
+  std::vector<double> seed;
+  kinematic_state->copyJointGroupPositions(arm.arm_joint_model_group, seed);
+  GraspIk ik = [&](const geometry_msgs::msg::Pose &pose, std::vector<double> &joint_values)
+  { return pnp->ik_solver()->solve(pose, joint_values, &seed); };
+
+  GraspChoice choice;
+  arm.pose = candidates.front();
+  if (select_grasp(candidates, seed, ik, choice))
+  {
+    arm.pose = candidates[choice.index];
+    RCLCPP_INFO(LOGGER, "Candidate %zu of %zu (%zu reachable), %.3f rad away", choice.index, candidates.size(),
+                choice.reachable, choice.distance);
+  }
+}
+
+// Plans both arms from `start` to their joint values in arm_system, in
+// dual_arm or decoupled
+static bool plan_dual(dual_arm_state &arm_system, moveit::planning_interface::MoveGroupInterface &dual_arm,
+                      const moveit::core::RobotState &start, moveit::planning_interface::MoveGroupInterface::Plan &plan)
+{
+  if (decoupled_planner)
+  {
+    return decoupled_planner->plan(start, arm_system.arm_1.arm_joint_values, arm_system.arm_2.arm_joint_values, plan);
+  }
+
+  dual_arm.setStartState(start);
+  bool success = dual_arm.plan(plan) == moveit::core::MoveItErrorCode::SUCCESS && !plan.trajectory_.joint_trajectory.points.empty();
+  dual_arm.setStartStateToCurrentState();
+  return success;
+}
+
+// Plans the current targets from where the last deferred plan ends, or from
+// the current state if there is none, and appends the plan
+static bool plan_deferred(dual_arm_state &arm_system, moveit::planning_interface::MoveGroupInterface &dual_arm,
+                          std::vector<moveit::planning_interface::MoveGroupInterface::Plan> &deferred)
+{
+  moveit::core::RobotState start(*dual_arm.getCurrentState());
+  if (!deferred.empty())
+  {
+    const auto &last = deferred.back().trajectory_.joint_trajectory;
+    start.setVariablePositions(last.joint_names, last.points.back().positions);
+  }
+
+  moveit::planning_interface::MoveGroupInterface::Plan plan;
+  bool success = plan_dual(arm_system, dual_arm, start, plan);
+  if (success)
+  {
+    deferred.push_back(plan);
+  }
+  return success;
+}
+
+bool execute_deferred(moveit::planning_interface::MoveGroupInterface &dual_arm, TrajectoryBlender &blender,
+                      std::vector<moveit::planning_interface::MoveGroupInterface::Plan> &deferred)
+{
+  std::vector<moveit::planning_interface::MoveGroupInterface::Plan> plans;
+  plans.swap(deferred);
+  if (plans.empty())
+  {
+    return true;
+  }
+
+  std::vector<moveit_msgs::msg::RobotTrajectory> trajectories;
+  for (const auto &plan : plans)
+  {
+    trajectories.push_back(plan.trajectory_);
+  }
+
+  moveit::planning_interface::MoveGroupInterface::Plan joined = plans.front();
+  if (plans.size() > 1 && blender.blend(plans.front().start_state_, trajectories, joined.trajectory_))
+  {
+    return dual_arm.execute(joined) == moveit::core::MoveItErrorCode::SUCCESS;
+  }
+
+  for (const auto &plan : plans)
+  {
+    if (dual_arm.execute(plan) != moveit::core::MoveItErrorCode::SUCCESS)
+    {
+      return false;
+    }
+  }
+  return true;
 }
 
 bool plan_and_move(dual_arm_state &arm_system, Movement movement, moveit::core::RobotStatePtr kinematic_state,
                    double timeout, moveit::planning_interface::MoveGroupInterface &dual_arm, tray_helper *active_tray_arm_1,
-                   tray_helper *active_tray_arm_2)
+                   tray_helper *active_tray_arm_2,
+                   std::vector<moveit::planning_interface::MoveGroupInterface::Plan> *deferred, MotionPipeline *pipeline)
 {
   static int cache_1;
   static int cache_2;
@@ -245,23 +485,8 @@ bool plan_and_move(dual_arm_state &arm_system, Movement movement, moveit::core::
   {
 
     RCLCPP_INFO(LOGGER, "[Movement type pregrasp]");
-    arm_system.arm_1.pose.position.x = arm_system.arm_1.object.collisionObject.pose.position.x;
-    arm_system.arm_1.pose.position.y = arm_system.arm_1.object.collisionObject.pose.position.y;
-    arm_system.arm_1.pose.position.z = arm_system.arm_1.object.collisionObject.pose.position.z + 0.25;
-
-    arm_system.arm_1.pose.orientation.x = arm_system.arm_1.object.collisionObject.pose.orientation.w;
-    arm_system.arm_1.pose.orientation.y = arm_system.arm_1.object.collisionObject.pose.orientation.z;
-    arm_system.arm_1.pose.orientation.z = 0;
-    arm_system.arm_1.pose.orientation.w = 0;
-
-    arm_system.arm_2.pose.position.x = arm_system.arm_2.object.collisionObject.pose.position.x;
-    arm_system.arm_2.pose.position.y = arm_system.arm_2.object.collisionObject.pose.position.y;
-    arm_system.arm_2.pose.position.z = arm_system.arm_2.object.collisionObject.pose.position.z + 0.25;
-
-    arm_system.arm_2.pose.orientation.x = arm_system.arm_2.object.collisionObject.pose.orientation.w;
-    arm_system.arm_2.pose.orientation.y = arm_system.arm_2.object.collisionObject.pose.orientation.z;
-    arm_system.arm_2.pose.orientation.z = 0;
-    arm_system.arm_2.pose.orientation.w = 0;
+    choose_pose(pnp_1, kinematic_state, arm_system.arm_1, box_grasps(arm_system.arm_1.object.collisionObject, 0.25));
+    choose_pose(pnp_2, kinematic_state, arm_system.arm_2, box_grasps(arm_system.arm_2.object.collisionObject, 0.25));
   }
   else if (movement == Movement::GRASP)
   {
@@ -278,23 +503,23 @@ bool plan_and_move(dual_arm_state &arm_system, Movement movement, moveit::core::
   else if (movement == Movement::MOVE)
   {
     RCLCPP_INFO(LOGGER, "[Movement type move]");
-    arm_system.arm_1.pose.position.x = active_tray_arm_1->get_x();
-    arm_system.arm_1.pose.position.y = active_tray_arm_1->get_y();
-    arm_system.arm_1.pose.position.z = 1.28 + active_tray_arm_1->z * 0.05;
+    geometry_msgs::msg::Pose tray_pose;
+    tray_pose.orientation.x = 1;
+    tray_pose.orientation.w = 0;
 
-    arm_system.arm_1.pose.orientation.x = 1;
-    arm_system.arm_1.pose.orientation.y = 0;
+    tray_pose.position.x = active_tray_arm_1->get_x();
+    tray_pose.position.y = active_tray_arm_1->get_y();
+    tray_pose.position.z = 1.28 + active_tray_arm_1->z * 0.05;
+    choose_pose(pnp_1, kinematic_state, arm_system.arm_1, place_candidates(tray_pose));
 
     cache_1 = active_tray_arm_1->z * 0.05;
 
     active_tray_arm_1->next();
 
-    arm_system.arm_2.pose.position.x = active_tray_arm_2->get_x();
-    arm_system.arm_2.pose.position.y = active_tray_arm_2->get_y();
-    arm_system.arm_2.pose.position.z = 1.28 + active_tray_arm_2->z * 0.05;
-
-    arm_system.arm_2.pose.orientation.x = 1;
-    arm_system.arm_2.pose.orientation.y = 0;
+    tray_pose.position.x = active_tray_arm_2->get_x();
+    tray_pose.position.y = active_tray_arm_2->get_y();
+    tray_pose.position.z = 1.28 + active_tray_arm_2->z * 0.05;
+    choose_pose(pnp_2, kinematic_state, arm_system.arm_2, place_candidates(tray_pose));
 
     cache_2 = active_tray_arm_2->z * 0.05;
 
@@ -320,8 +545,8 @@ bool plan_and_move(dual_arm_state &arm_system, Movement movement, moveit::core::
   while (!executionSuccessful)
   {
 
-    bool a_bot_found_ik = kinematic_state->setFromIK(arm_system.arm_1.arm_joint_model_group, arm_system.arm_1.pose, timeout);
-    bool b_bot_found_ik = kinematic_state->setFromIK(arm_system.arm_2.arm_joint_model_group, arm_system.arm_2.pose, timeout);
+    bool a_bot_found_ik = false, b_bot_found_ik = false;
+    solve_ik_pair(kinematic_state, arm_system, a_bot_found_ik, b_bot_found_ik);
 
     if (a_bot_found_ik)
     {
@@ -353,7 +578,19 @@ bool plan_and_move(dual_arm_state &arm_system, Movement movement, moveit::core::
       // }
       // executionSuccessful = dual_arm.execute(my_plan) == moveit::core::MoveItErrorCode::SUCCESS;
       //dual_arm.move() -
-      executionSuccessful = dual_arm.move() == moveit::core::MoveItErrorCode::SUCCESS;
+      if (deferred)
+        executionSuccessful = plan_deferred(arm_system, dual_arm, *deferred);
+      else if (pipeline)
+      {
+        MotionPipeline::Planner planner = [&](const moveit::core::RobotState &start, moveit::planning_interface::MoveGroupInterface::Plan &plan)
+        { return plan_dual(arm_system, dual_arm, start, plan); };
+        executionSuccessful = planner(pipeline->predictedStart(), my_plan) && pipeline->submit(my_plan, planner);
+      }
+      else if (decoupled_planner)
+        executionSuccessful = plan_dual(arm_system, dual_arm, *dual_arm.getCurrentState(), my_plan) &&
+                              dual_arm.execute(my_plan) == moveit::core::MoveItErrorCode::SUCCESS;
+      else
+        executionSuccessful = dual_arm.move() == moveit::core::MoveItErrorCode::SUCCESS;
       if(!executionSuccessful){
           objs.push(arm_system.arm_1.object);
           objs.push(arm_system.arm_2.object);
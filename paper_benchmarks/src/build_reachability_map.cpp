@@ -0,0 +1,185 @@
+#include <rclcpp/rclcpp.hpp>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/robot_state.h>
+#include <Eigen/Dense>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "paper_benchmarks/primitive_pick_and_place.hpp"
+#include "paper_benchmarks/reachability_map.hpp"
+
+// Samples the table workspace on a voxel grid and stores, per arm, how well
+// a cube centred in each voxel can be grasped: the share of grasp yaws for
+// which both the pregrasp and the grasp pose have an IK solution, weighted
+// with the arm's manipulability at the grasp pose. The voxels are split
+// over all cores.
+
+const rclcpp::Logger LOGGER = rclcpp::get_logger("build_reachability_map");
+
+struct sampling_config
+{
+  float min_corner[3];
+  float resolution;
+  uint32_t size[3];
+  int yaw_samples;
+  double ik_timeout;
+};
+
+static double manipulability(moveit::core::RobotState &state, const moveit::core::JointModelGroup *jmg)
+{
+  Eigen::MatrixXd jacobian = state.getJacobian(jmg);
+  double det = (jacobian * jacobian.transpose()).determinant();
+  return det > 0 ? std::sqrt(det) : 0;
+}
+
+static ReachabilityMap build_map(rclcpp::Node::SharedPtr node, const std::string &group, const sampling_config &config,
+                                 unsigned int thread_count)
+{
+  ReachabilityMap map(config.min_corner, config.resolution, config.size);
+  std::vector<double> raw(map.voxelCount(), 0);
+  std::atomic<size_t> next_voxel(0);
+
+  auto worker = [&]()
+  {
+    // kinematics solvers are not guaranteed to be thread safe, so every
+    // worker loads its own model and solver instances
+    robot_model_loader::RobotModelLoader loader(node, "robot_description");
+    moveit::core::RobotModelConstPtr model = loader.getModel();
+    moveit::core::RobotState state(model);
+    state.setToDefaultValues();
+    const moveit::core::JointModelGroup *jmg = model->getJointModelGroup(group);
+
+    moveit_msgs::msg::CollisionObject cube;
+    for (size_t i = next_voxel++; i < map.voxelCount(); i = next_voxel++)
+    {
+      float x, y, z;
+      map.centre(i, x, y, z);
+      cube.pose.position.x = x;
+      cube.pose.position.y = y;
+      cube.pose.position.z = z;
+
+      // the box is symmetric, so yaws in [0, pi/2) cover every grasp
+      int solved = 0;
+      double best_manipulability = 0;
+      for (int k = 0; k < config.yaw_samples; ++k)
+      {
+        double yaw = 0.5 * M_PI * k / config.yaw_samples;
+        cube.pose.orientation.x = 0;
+        cube.pose.orientation.y = 0;
+        cube.pose.orientation.z = std::sin(yaw / 2);
+        cube.pose.orientation.w = std::cos(yaw / 2);
+
+        if (!state.setFromIK(jmg, approach_pose(cube, 0.25), config.ik_timeout))
+          continue;
+        if (!state.setFromIK(jmg, approach_pose(cube, 0.1), config.ik_timeout))
+          continue;
+
+        solved++;
+        best_manipulability = std::max(best_manipulability, manipulability(state, jmg));
+      }
+
+      raw[i] = solved > 0 ? best_manipulability * solved / config.yaw_samples : 0;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned int t = 0; t < thread_count; ++t)
+  {
+    threads.emplace_back(worker);
+  }
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+
+  // scale to 1..255 for reachable voxels, 0 stays unreachable
+  double max_raw = 0;
+  for (double r : raw)
+  {
+    max_raw = std::max(max_raw, r);
+  }
+  size_t reachable = 0;
+  for (size_t i = 0; i < raw.size(); ++i)
+  {
+    if (raw[i] > 0)
+    {
+      map.set(i, static_cast<uint8_t>(1 + std::lround(254 * raw[i] / max_raw)));
+      reachable++;
+    }
+  }
+
+  RCLCPP_INFO(LOGGER, "%s: %zu of %zu voxels reachable", group.c_str(), reachable, map.voxelCount());
+  return map;
+}
+
+int main(int argc, char **argv)
+{
+  rclcpp::init(argc, argv);
+
+  rclcpp::NodeOptions options;
+  options.automatically_declare_parameters_from_overrides(true);
+  auto node = rclcpp::Node::make_shared("build_reachability_map", options);
+
+  std::string output_directory;
+  double resolution, ik_timeout;
+  int yaw_samples, threads;
+  std::vector<double> min_corner, max_corner;
+  node->get_parameter_or("outputDirectory", output_directory, std::string("."));
+  node->get_parameter_or("resolution", resolution, 0.02);
+  node->get_parameter_or("minCorner", min_corner, std::vector<double>{-0.5, -1.0, 1.0});
+  node->get_parameter_or("maxCorner", max_corner, std::vector<double>{0.5, 1.0, 1.1});
+  node->get_parameter_or("yawSamples", yaw_samples, 4);
+  node->get_parameter_or("ikTimeout", ik_timeout, 0.05);
+  node->get_parameter_or("threads", threads, 0);
+
+  if (min_corner.size() != 3 || max_corner.size() != 3)
+  {
+    RCLCPP_ERROR(LOGGER, "minCorner and maxCorner need 3 values each (x, y, z), got %zu and %zu", min_corner.size(),
+                 max_corner.size());
+    rclcpp::shutdown();
+    return 1;
+  }
+  for (int a = 0; a < 3; ++a)
+  {
+    if (!(max_corner[a] > min_corner[a]) || !(resolution > 0))
+    {
+      RCLCPP_ERROR(LOGGER, "The map is empty: maxCorner has to lie above minCorner on every axis and resolution has to be positive");
+      rclcpp::shutdown();
+      return 1;
+    }
+  }
+
+  sampling_config config;
+  config.resolution = resolution;
+  config.yaw_samples = std::max(1, yaw_samples);
+  config.ik_timeout = ik_timeout;
+  for (int a = 0; a < 3; ++a)
+  {
+    config.min_corner[a] = min_corner[a];
+    config.size[a] = static_cast<uint32_t>(std::ceil((max_corner[a] - min_corner[a]) / resolution));
+  }
+
+  unsigned int thread_count = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+  RCLCPP_INFO(LOGGER, "Sampling %u x %u x %u voxels on %u threads", config.size[0], config.size[1], config.size[2],
+              thread_count);
+
+  for (const std::string group : {"panda_1", "panda_2"})
+  {
+    auto start = std::chrono::steady_clock::now();
+    ReachabilityMap map = build_map(node, group, config, thread_count);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::string path = output_directory + "/" + group + ".reach";
+    if (!map.save(path))
+    {
+      RCLCPP_ERROR(LOGGER, "Could not write %s", path.c_str());
+      rclcpp::shutdown();
+      return 1;
+    }
+    RCLCPP_INFO(LOGGER, "Wrote %s in %.1f s", path.c_str(), elapsed);
+  }
+
+  rclcpp::shutdown();
+  return 0;
+}
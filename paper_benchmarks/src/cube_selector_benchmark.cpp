@@ -0,0 +1,108 @@
+#include "paper_benchmarks/cube_selector.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Microbenchmark for the nearest-cube selection kernels. Compares the
+// original scan over the CollisionObject messages (sqrt per cube) with the
+// scalar and vectorized scans of the packed position mirror and with the
+// k-d tree index, at 1k, 10k and 100k cubes.
+
+namespace
+{
+
+volatile size_t sink;
+
+float messageScan(const std::vector<CollisionObject> &cubes, const Point3D &p, size_t &best)
+{
+  float min_distance = std::numeric_limits<float>::max();
+  for (size_t i = 0; i < cubes.size(); ++i)
+  {
+    float dx = cubes[i].pose.position.x - p.x;
+    float dy = cubes[i].pose.position.y - p.y;
+    float dz = cubes[i].pose.position.z - p.z;
+    float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+    if (distance < min_distance)
+    {
+      min_distance = distance;
+      best = i;
+    }
+  }
+  return min_distance;
+}
+
+template <typename F>
+double nanosecondsPerQuery(const std::vector<Point3D> &queries, F query)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (const Point3D &q : queries)
+  {
+    sink = query(q);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / queries.size();
+}
+
+} // namespace
+
+int main()
+{
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<float> table_x(-0.35, 0.35);
+  std::uniform_real_distribution<float> table_y(-0.25, 0.25);
+
+#if defined(__AVX2__)
+  const char *simd = "avx2";
+#elif defined(__SSE2__)
+  const char *simd = "sse2";
+#else
+  const char *simd = "scalar";
+#endif
+  std::cout << "vector kernel: " << simd << std::endl;
+  std::cout << std::setw(8) << "cubes" << std::setw(14) << "messages" << std::setw(14) << "soa scalar"
+            << std::setw(14) << "soa simd" << std::setw(14) << "kd-tree" << std::setw(12) << "simd gain" << std::endl;
+
+  for (size_t n : {1000, 10000, 100000})
+  {
+    std::vector<CollisionObject> messages(n);
+    CubePositionsSoA positions;
+    CubeKdTree tree;
+    for (size_t i = 0; i < n; ++i)
+    {
+      messages[i].id = "box_" + std::to_string(i);
+      messages[i].pose.position.x = table_x(gen);
+      messages[i].pose.position.y = table_y(gen);
+      messages[i].pose.position.z = 1.026;
+      const auto &position = messages[i].pose.position;
+      positions.set(i, position.x, position.y, position.z, CubePositionsSoA::LIVE);
+      tree.insert(i, position.x, position.y, position.z);
+    }
+
+    size_t query_count = 20000000 / n;
+    std::vector<Point3D> queries;
+    for (size_t i = 0; i < query_count; ++i)
+    {
+      queries.emplace_back(table_x(gen), table_y(gen) * 2, 1.0);
+    }
+
+    double message_ns = nanosecondsPerQuery(queries, [&](const Point3D &q)
+                                            { size_t best = 0; messageScan(messages, q, best); return best; });
+    double scalar_ns = nanosecondsPerQuery(queries, [&](const Point3D &q)
+                                           { float d; return cube_distance::argminScalar(positions.x.data(), positions.y.data(), positions.z.data(),
+                                                                                         positions.flags.data(), n, q.x, q.y, q.z,
+                                                                                         CubePositionsSoA::LIVE, 0, d); });
+    double simd_ns = nanosecondsPerQuery(queries, [&](const Point3D &q)
+                                         { float d; return cube_distance::argmin(positions, q.x, q.y, q.z, CubePositionsSoA::LIVE, 0, d); });
+    double tree_ns = nanosecondsPerQuery(queries, [&](const Point3D &q)
+                                         { size_t slot = 0; tree.nearest(q.x, q.y, q.z, slot); return slot; });
+
+    std::cout << std::setw(8) << n << std::fixed << std::setprecision(1)
+              << std::setw(11) << message_ns << " ns" << std::setw(11) << scalar_ns << " ns"
+              << std::setw(11) << simd_ns << " ns" << std::setw(11) << tree_ns << " ns"
+              << std::setw(11) << message_ns / simd_ns << "x" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,129 @@
+#include <rclcpp/rclcpp.hpp>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/robot_state.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "paper_benchmarks/panda_batch_fk.hpp"
+#include "paper_benchmarks/grasp_configuration_map.hpp"
+
+// Compares the batch FK of panda_batch_fk.hpp with RobotState on the same
+// random configurations of panda_1: setJointGroupPositions followed by
+// getGlobalLinkTransform of the flange, and of all eight links. Reports
+// the time per configuration and the largest deviation of the batch
+// result, and how long building the GraspConfigurationMap takes.
+
+const rclcpp::Logger LOGGER = rclcpp::get_logger("fk_benchmark");
+
+volatile double sink;
+
+int main(int argc, char **argv)
+{
+  rclcpp::init(argc, argv);
+
+  rclcpp::NodeOptions options;
+  options.automatically_declare_parameters_from_overrides(true);
+  auto node = rclcpp::Node::make_shared("fk_benchmark", options);
+
+  int configurations;
+  node->get_parameter_or("configurations", configurations, 100000);
+  size_t n = static_cast<size_t>(std::max(1, configurations));
+
+  robot_model_loader::RobotModelLoader model_loader(node, "robot_description", false);
+  moveit::core::RobotModelConstPtr model = model_loader.getModel();
+  moveit::core::RobotState state(model);
+  state.setToDefaultValues();
+
+  const moveit::core::JointModelGroup *jmg = model->getJointModelGroup("panda_1");
+  const moveit::core::LinkModel *base = model->getLinkModel("panda_1_link0");
+  std::vector<const moveit::core::LinkModel *> links;
+  for (size_t l = 1; l <= panda_fk::link_count; ++l)
+  {
+    links.push_back(model->getLinkModel("panda_1_link" + std::to_string(l)));
+  }
+
+#if defined(__AVX2__)
+  const char *simd = "avx2";
+#elif defined(__SSE2__)
+  const char *simd = "sse2";
+#else
+  const char *simd = "scalar";
+#endif
+  RCLCPP_INFO(LOGGER, "vector kernel: %s, %zu configurations", simd, n);
+
+  std::vector<std::vector<double>> samples(n);
+  panda_fk::JointsSoA joints;
+  joints.resize(n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    state.setToRandomPositions(jmg);
+    state.copyJointGroupPositions(jmg, samples[i]);
+    joints.set(i, samples[i].data());
+  }
+
+  // RobotState, one configuration at a time
+  auto start = std::chrono::steady_clock::now();
+  for (const auto &q : samples)
+  {
+    state.setJointGroupPositions(jmg, q);
+    sink = state.getGlobalLinkTransform(links.back()).translation().x();
+  }
+  double state_flange_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+
+  start = std::chrono::steady_clock::now();
+  for (const auto &q : samples)
+  {
+    state.setJointGroupPositions(jmg, q);
+    for (const auto *link : links)
+    {
+      sink = state.getGlobalLinkTransform(link).translation().x();
+    }
+  }
+  double state_links_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+
+  // batch FK
+  panda_fk::FramesSoA flange;
+  start = std::chrono::steady_clock::now();
+  panda_fk::flangePoses(joints, flange);
+  double batch_flange_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+
+  std::array<panda_fk::FramesSoA, panda_fk::link_count> frames;
+  start = std::chrono::steady_clock::now();
+  panda_fk::linkFrames(joints, frames);
+  double batch_links_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+
+  // deviation in the link0 frame, over every link
+  double worst_position = 0, worst_rotation = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    state.setJointGroupPositions(jmg, samples[i]);
+    Eigen::Isometry3d base_inverse = state.getGlobalLinkTransform(base).inverse();
+    for (size_t l = 0; l < links.size(); ++l)
+    {
+      Eigen::Isometry3d t = base_inverse * state.getGlobalLinkTransform(links[l]);
+      for (int k = 0; k < 3; ++k)
+      {
+        worst_position = std::max(worst_position, std::fabs(t.translation()[k] - frames[l].p[k][i]));
+        for (int c = 0; c < 3; ++c)
+        {
+          worst_rotation = std::max(worst_rotation, std::fabs(t.linear()(k, c) - frames[l].r[c * 3 + k][i]));
+        }
+      }
+    }
+  }
+
+  start = std::chrono::steady_clock::now();
+  GraspConfigurationMap map(0.276);
+  double map_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  RCLCPP_INFO(LOGGER, "[metric] flange: RobotState %.1f ns, batch %.1f ns, speedup %.1fx", state_flange_ns, batch_flange_ns,
+              state_flange_ns / batch_flange_ns);
+  RCLCPP_INFO(LOGGER, "[metric] all links: RobotState %.1f ns, batch %.1f ns, speedup %.1fx", state_links_ns, batch_links_ns,
+              state_links_ns / batch_links_ns);
+  RCLCPP_INFO(LOGGER, "[metric] worst deviation %.2e m, %.2e in the rotation", worst_position, worst_rotation);
+  RCLCPP_INFO(LOGGER, "[metric] grasp configuration map: %zu configurations in %.3f s", map.size(), map_seconds);
+
+  rclcpp::shutdown();
+  return 0;
+}
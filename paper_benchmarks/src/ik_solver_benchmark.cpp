@@ -0,0 +1,166 @@
+#include <rclcpp/rclcpp.hpp>
+#include <moveit/kinematics_base/kinematics_base.h>
+#include <moveit/robot_model_loader/robot_model_loader.h>
+#include <moveit/robot_state/robot_state.h>
+#include <pluginlib/class_loader.hpp>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+// Compares IK plugins on the poses the benchmarks ask for: top-down grasps
+// over the table workspace of each arm at several yaws and heights. Every
+// plugin is seeded with the home configuration and gets the same timeout.
+// Reported per plugin: success rate, mean and worst solve time, and the
+// position and orientation error of the solution measured with the robot
+// model's own forward kinematics.
+
+const rclcpp::Logger LOGGER = rclcpp::get_logger("ik_solver_benchmark");
+
+struct solver_result
+{
+  size_t attempts = 0;
+  size_t solved = 0;
+  double total_time = 0;
+  double worst_time = 0;
+  double worst_position_error = 0;
+  double worst_orientation_error = 0;
+};
+
+static std::vector<geometry_msgs::msg::Pose> table_poses(double base_y, double resolution, int yaw_samples)
+{
+  // the link0 frame sits on the table top at (0, base_y, 1); the heights are
+  // the grasp, tray putdown and pregrasp heights of the flange
+  std::vector<geometry_msgs::msg::Pose> poses;
+  for (double x = -0.45; x <= 0.45 + 1e-9; x += resolution)
+  {
+    for (double y = -0.95; y <= 0.95 + 1e-9; y += resolution)
+    {
+      for (double z : {0.126, 0.141, 0.276})
+      {
+        for (int k = 0; k < yaw_samples; ++k)
+        {
+          double yaw = M_PI * k / yaw_samples;
+          Eigen::Quaterniond q = Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()) * Eigen::AngleAxisd(M_PI, Eigen::Vector3d::UnitX());
+          geometry_msgs::msg::Pose pose;
+          pose.position.x = x;
+          pose.position.y = y - base_y;
+          pose.position.z = z;
+          pose.orientation.x = q.x();
+          pose.orientation.y = q.y();
+          pose.orientation.z = q.z();
+          pose.orientation.w = q.w();
+          poses.push_back(pose);
+        }
+      }
+    }
+  }
+  return poses;
+}
+
+static solver_result run(kinematics::KinematicsBase &solver, moveit::core::RobotState &state,
+                         const moveit::core::JointModelGroup *jmg, const std::vector<geometry_msgs::msg::Pose> &poses,
+                         const std::vector<double> &seed, double timeout)
+{
+  solver_result result;
+  const moveit::core::LinkModel *base = state.getRobotModel()->getLinkModel(solver.getBaseFrame());
+  const moveit::core::LinkModel *tip = state.getRobotModel()->getLinkModel(solver.getTipFrame());
+
+  for (const auto &pose : poses)
+  {
+    std::vector<double> solution;
+    moveit_msgs::msg::MoveItErrorCodes error_code;
+
+    auto start = std::chrono::steady_clock::now();
+    bool found = solver.searchPositionIK(pose, seed, timeout, solution, error_code);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    result.attempts++;
+    result.total_time += elapsed;
+    result.worst_time = std::max(result.worst_time, elapsed);
+    if (!found)
+      continue;
+    result.solved++;
+
+    state.setJointGroupPositions(jmg, solution);
+    state.updateLinkTransforms();
+    Eigen::Isometry3d reached = state.getGlobalLinkTransform(base).inverse() * state.getGlobalLinkTransform(tip);
+    Eigen::Vector3d target_position(pose.position.x, pose.position.y, pose.position.z);
+    Eigen::Quaterniond target_orientation(pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z);
+
+    result.worst_position_error = std::max(result.worst_position_error, (reached.translation() - target_position).norm());
+    result.worst_orientation_error =
+        std::max(result.worst_orientation_error, Eigen::Quaterniond(reached.linear()).angularDistance(target_orientation));
+  }
+  return result;
+}
+
+int main(int argc, char **argv)
+{
+  rclcpp::init(argc, argv);
+
+  rclcpp::NodeOptions options;
+  options.automatically_declare_parameters_from_overrides(true);
+  auto node = rclcpp::Node::make_shared("ik_solver_benchmark", options);
+
+  double resolution, timeout, search_resolution;
+  int yaw_samples;
+  std::vector<std::string> plugins;
+  node->get_parameter_or("resolution", resolution, 0.05);
+  node->get_parameter_or("yawSamples", yaw_samples, 4);
+  node->get_parameter_or("timeout", timeout, 0.05);
+  node->get_parameter_or("searchResolution", search_resolution, 0.005);
+  node->get_parameter_or("plugins", plugins,
+                         std::vector<std::string>{"kdl_kinematics_plugin/KDLKinematicsPlugin",
+                                                  "paper_benchmarks/PandaAnalyticKinematicsPlugin"});
+
+  robot_model_loader::RobotModelLoader model_loader(node, "robot_description", false);
+  moveit::core::RobotModelConstPtr model = model_loader.getModel();
+  moveit::core::RobotState state(model);
+  state.setToDefaultValues();
+
+  pluginlib::ClassLoader<kinematics::KinematicsBase> plugin_loader("moveit_core", "kinematics::KinematicsBase");
+
+  const std::pair<const char *, double> arms[] = {{"panda_1", -0.5}, {"panda_2", 0.5}};
+  for (const auto &arm : arms)
+  {
+    const moveit::core::JointModelGroup *jmg = model->getJointModelGroup(arm.first);
+    std::vector<double> home;
+    state.setToDefaultValues(jmg, "home");
+    state.copyJointGroupPositions(jmg, home);
+
+    std::vector<geometry_msgs::msg::Pose> poses = table_poses(arm.second, resolution, yaw_samples);
+    std::string base = std::string(arm.first) + "_link0";
+    std::string tip = std::string(arm.first) + "_link8";
+
+    for (const std::string &name : plugins)
+    {
+      std::shared_ptr<kinematics::KinematicsBase> solver;
+      try
+      {
+        solver = plugin_loader.createSharedInstance(name);
+      }
+      catch (const pluginlib::PluginlibException &e)
+      {
+        RCLCPP_ERROR(LOGGER, "Could not load %s: %s", name.c_str(), e.what());
+        continue;
+      }
+      if (!solver->initialize(node, *model, arm.first, base, {tip}, search_resolution))
+      {
+        RCLCPP_ERROR(LOGGER, "Could not initialise %s for %s", name.c_str(), arm.first);
+        continue;
+      }
+
+      solver_result r = run(*solver, state, jmg, poses, home, timeout);
+      RCLCPP_INFO(LOGGER, "[metric] %s %s: solved %zu/%zu (%.1f%%), mean %.3f ms, worst %.3f ms, "
+                          "worst error %.2e m / %.2e rad",
+                  arm.first, name.c_str(), r.solved, r.attempts, 100.0 * r.solved / std::max<size_t>(1, r.attempts),
+                  1000 * r.total_time / std::max<size_t>(1, r.attempts), 1000 * r.worst_time, r.worst_position_error,
+                  r.worst_orientation_error);
+    }
+  }
+
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,242 @@
+#include <moveit/kinematics_base/kinematics_base.h>
+#include <moveit/robot_model/robot_model.h>
+#include <pluginlib/class_list_macros.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <algorithm>
+#include <chrono>
+#include "paper_benchmarks/panda_analytic_ik.hpp"
+
+// Kinematics plugin for panda_1 and panda_2 built on the closed-form solver
+// in panda_analytic_ik.hpp. Select it in kinematics.yaml with
+//   kinematics_solver: paper_benchmarks/PandaAnalyticKinematicsPlugin
+// kinematics_solver_search_resolution is the q7 step of the redundancy
+// sweep, which starts at the seed's q7 and works outwards until a solution
+// is accepted or the timeout expires.
+
+namespace paper_benchmarks
+{
+
+static const rclcpp::Logger LOGGER = rclcpp::get_logger("panda_analytic_kinematics_plugin");
+
+class PandaAnalyticKinematicsPlugin : public kinematics::KinematicsBase
+{
+private:
+    std::vector<std::string> joint_names;
+    std::vector<std::string> link_names;
+    panda_ik::Limits limits;
+
+    static Eigen::Isometry3d toEigen(const geometry_msgs::msg::Pose &pose)
+    {
+        Eigen::Isometry3d t = Eigen::Isometry3d::Identity();
+        t.translate(Eigen::Vector3d(pose.position.x, pose.position.y, pose.position.z));
+        t.rotate(Eigen::Quaterniond(pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z).normalized());
+        return t;
+    }
+
+    static geometry_msgs::msg::Pose toMsg(const Eigen::Isometry3d &t)
+    {
+        geometry_msgs::msg::Pose pose;
+        Eigen::Quaterniond q(t.linear());
+        pose.position.x = t.translation().x();
+        pose.position.y = t.translation().y();
+        pose.position.z = t.translation().z();
+        pose.orientation.x = q.x();
+        pose.orientation.y = q.y();
+        pose.orientation.z = q.z();
+        pose.orientation.w = q.w();
+        return pose;
+    }
+
+    static bool endsWith(const std::string &name, const std::string &suffix)
+    {
+        return name.size() >= suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    bool withinConsistency(const panda_ik::Joints &q, const std::vector<double> &seed,
+                           const std::vector<double> &consistency_limits) const
+    {
+        for (size_t i = 0; i < consistency_limits.size() && i < q.size(); ++i)
+        {
+            if (std::fabs(q[i] - seed[i]) > consistency_limits[i])
+                return false;
+        }
+        return true;
+    }
+
+public:
+    bool initialize(const rclcpp::Node::SharedPtr & /*node*/, const moveit::core::RobotModel &robot_model,
+                    const std::string &group_name, const std::string &base_frame, const std::vector<std::string> &tip_frames,
+                    double search_discretization) override
+    {
+        storeValues(robot_model, group_name, base_frame, tip_frames, search_discretization);
+
+        const moveit::core::JointModelGroup *jmg = robot_model.getJointModelGroup(group_name);
+        if (!jmg || !jmg->isChain() || tip_frames.size() != 1)
+        {
+            RCLCPP_ERROR(LOGGER, "Group '%s' is not a single chain", group_name.c_str());
+            return false;
+        }
+
+        // the solution is for poses of the flange in the frame of link0, any
+        // other base or tip would need a fixed offset the plugin does not apply
+        if (!endsWith(base_frame_, "_link0") || !endsWith(tip_frames_.front(), "_link8"))
+        {
+            RCLCPP_ERROR(LOGGER, "Group '%s' runs from %s to %s, the analytic IK only solves a Panda arm from link0 to link8",
+                         group_name.c_str(), base_frame_.c_str(), tip_frames_.front().c_str());
+            return false;
+        }
+
+        joint_names = jmg->getActiveJointModelNames();
+        if (joint_names.size() != 7)
+        {
+            RCLCPP_ERROR(LOGGER, "Group '%s' has %zu joints, a Panda arm has 7", group_name.c_str(), joint_names.size());
+            return false;
+        }
+        link_names = tip_frames;
+
+        // use the bounds MoveIt works with rather than the built-in ones
+        const moveit::core::JointBoundsVector &bounds = jmg->getActiveJointModelsBounds();
+        for (size_t i = 0; i < 7; ++i)
+        {
+            limits.lower[i] = (*bounds[i])[0].min_position_;
+            limits.upper[i] = (*bounds[i])[0].max_position_;
+        }
+
+        if (search_discretization_ <= 0)
+            search_discretization_ = 0.005;
+
+        RCLCPP_INFO(LOGGER, "Analytic IK for %s (%s -> %s), q7 step %.4f", group_name.c_str(), base_frame.c_str(),
+                    tip_frames.front().c_str(), search_discretization_);
+        return true;
+    }
+
+    bool getPositionIK(const geometry_msgs::msg::Pose &ik_pose, const std::vector<double> &ik_seed_state,
+                       std::vector<double> &solution, moveit_msgs::msg::MoveItErrorCodes &error_code,
+                       const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const override
+    {
+        return searchPositionIK(ik_pose, ik_seed_state, default_timeout_, std::vector<double>(), solution, IKCallbackFn(),
+                                error_code, options);
+    }
+
+    bool searchPositionIK(const geometry_msgs::msg::Pose &ik_pose, const std::vector<double> &ik_seed_state, double timeout,
+                          std::vector<double> &solution, moveit_msgs::msg::MoveItErrorCodes &error_code,
+                          const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const override
+    {
+        return searchPositionIK(ik_pose, ik_seed_state, timeout, std::vector<double>(), solution, IKCallbackFn(), error_code,
+                                options);
+    }
+
+    bool searchPositionIK(const geometry_msgs::msg::Pose &ik_pose, const std::vector<double> &ik_seed_state, double timeout,
+                          const std::vector<double> &consistency_limits, std::vector<double> &solution,
+                          moveit_msgs::msg::MoveItErrorCodes &error_code,
+                          const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const override
+    {
+        return searchPositionIK(ik_pose, ik_seed_state, timeout, consistency_limits, solution, IKCallbackFn(), error_code,
+                                options);
+    }
+
+    bool searchPositionIK(const geometry_msgs::msg::Pose &ik_pose, const std::vector<double> &ik_seed_state, double timeout,
+                          std::vector<double> &solution, const IKCallbackFn &solution_callback,
+                          moveit_msgs::msg::MoveItErrorCodes &error_code,
+                          const kinematics::KinematicsQueryOptions &options = kinematics::KinematicsQueryOptions()) const override
+    {
+        return searchPositionIK(ik_pose, ik_seed_state, timeout, std::vector<double>(), solution, solution_callback,
+                                error_code, options);
+    }
+
+    bool searchPositionIK(const geometry_msgs::msg::Pose &ik_pose, const std::vector<double> &ik_seed_state, double timeout,
+                          const std::vector<double> &consistency_limits, std::vector<double> &solution,
+                          const IKCallbackFn &solution_callback, moveit_msgs::msg::MoveItErrorCodes &error_code,
+                          const kinematics::KinematicsQueryOptions & /*options*/ = kinematics::KinematicsQueryOptions()) const override
+    {
+        if (ik_seed_state.size() != 7)
+        {
+            error_code.val = moveit_msgs::msg::MoveItErrorCodes::NO_IK_SOLUTION;
+            return false;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                                std::chrono::duration<double>(timeout));
+        Eigen::Isometry3d target = toEigen(ik_pose);
+        panda_ik::Joints seed;
+        std::copy(ik_seed_state.begin(), ik_seed_state.end(), seed.begin());
+
+        // q7 may only move as far as its consistency limit allows
+        double q7_reach = limits.upper[6] - limits.lower[6];
+        if (consistency_limits.size() == 7)
+            q7_reach = std::min(q7_reach, consistency_limits[6]);
+        size_t steps = static_cast<size_t>(std::ceil(q7_reach / search_discretization_));
+
+        std::vector<panda_ik::Joints> candidates;
+        bool timed_out = false;
+        for (size_t i = 0; i <= steps; ++i)
+        {
+            if (i > 0 && std::chrono::steady_clock::now() > deadline)
+            {
+                timed_out = true;
+                break;
+            }
+
+            candidates.clear();
+            panda_ik::solve(target, seed[6] + i * search_discretization_, limits, candidates, seed[0]);
+            if (i > 0)
+                panda_ik::solve(target, seed[6] - i * search_discretization_, limits, candidates, seed[0]);
+
+            std::sort(candidates.begin(), candidates.end(), [&seed](const panda_ik::Joints &a, const panda_ik::Joints &b)
+                      { return panda_ik::distance(a, seed) < panda_ik::distance(b, seed); });
+
+            for (const panda_ik::Joints &candidate : candidates)
+            {
+                if (!withinConsistency(candidate, ik_seed_state, consistency_limits))
+                    continue;
+
+                solution.assign(candidate.begin(), candidate.end());
+                if (!solution_callback)
+                {
+                    error_code.val = moveit_msgs::msg::MoveItErrorCodes::SUCCESS;
+                    return true;
+                }
+
+                solution_callback(ik_pose, solution, error_code);
+                if (error_code.val == moveit_msgs::msg::MoveItErrorCodes::SUCCESS)
+                    return true;
+            }
+        }
+
+        error_code.val = timed_out ? moveit_msgs::msg::MoveItErrorCodes::TIMED_OUT : moveit_msgs::msg::MoveItErrorCodes::NO_IK_SOLUTION;
+        return false;
+    }
+
+    bool getPositionFK(const std::vector<std::string> &fk_link_names, const std::vector<double> &joint_angles,
+                       std::vector<geometry_msgs::msg::Pose> &poses) const override
+    {
+        if (joint_angles.size() != 7)
+            return false;
+
+        panda_ik::Joints q;
+        std::copy(joint_angles.begin(), joint_angles.end(), q.begin());
+        poses.clear();
+        for (const std::string &link : fk_link_names)
+        {
+            // the flange is the only link this solver knows
+            if (link != link_names.front())
+                return false;
+            poses.push_back(toMsg(panda_ik::forward(q)));
+        }
+        return true;
+    }
+
+    const std::vector<std::string> &getJointNames() const override
+    {
+        return joint_names;
+    }
+
+    const std::vector<std::string> &getLinkNames() const override
+    {
+        return link_names;
+    }
+};
+
+} // namespace paper_benchmarks
+
+PLUGINLIB_EXPORT_CLASS(paper_benchmarks::PandaAnalyticKinematicsPlugin, kinematics::KinematicsBase)
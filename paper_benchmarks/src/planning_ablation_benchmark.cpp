@@ -0,0 +1,169 @@
+#include <rclcpp/rclcpp.hpp>
+#include <moveit/move_group_interface/move_group_interface.h>
+#include <moveit/planning_scene_monitor/planning_scene_monitor.h>
+#include <moveit/robot_state/robot_state.h>
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "paper_benchmarks/decoupled_planner.hpp"
+
+// Plans the same dual arm goals once in the 14 dimensional dual_arm group
+// and once decoupled, panda_1 first and panda_2 around it, from the current
+// state and without executing. The goals are top-down poses at the pregrasp
+// height over each arm's half of the table, solved with IK and checked
+// against the scene. Reported per mode: success rate, mean and p95 planning
+// time, and the mean duration of the planned motions.
+
+const rclcpp::Logger LOGGER = rclcpp::get_logger("planning_ablation_benchmark");
+
+struct mode_result
+{
+  size_t planned = 0;
+  std::vector<double> planning_times;
+  double motion_time = 0;
+};
+
+static double motion_time(const moveit::planning_interface::MoveGroupInterface::Plan &plan)
+{
+  const auto &points = plan.trajectory_.joint_trajectory.points;
+  return points.empty() ? 0 : rclcpp::Duration(points.back().time_from_start).seconds();
+}
+
+static void report(const std::string &mode, const mode_result &result, size_t requests)
+{
+  std::vector<double> times = result.planning_times;
+  std::sort(times.begin(), times.end());
+  double mean = 0;
+  for (double t : times)
+  {
+    mean += t;
+  }
+  mean = times.empty() ? 0 : mean / times.size();
+  double p95 = times.empty() ? 0 : times[std::min(times.size() - 1, static_cast<size_t>(0.95 * times.size()))];
+
+  RCLCPP_INFO(LOGGER, "[metric] %s: %zu of %zu planned, planning time mean %.3f s, p95 %.3f s, motion time mean %.3f s", mode.c_str(),
+              result.planned, requests, mean, p95, result.planned ? result.motion_time / result.planned : 0.0);
+}
+
+// a top-down pose over the table at the pregrasp height, y in [y_min, y_max]
+static geometry_msgs::msg::Pose random_pose(std::mt19937 &random, double y_min, double y_max)
+{
+  std::uniform_real_distribution<double> x(-0.45, 0.45), y(y_min, y_max), yaw(-M_PI / 2, M_PI / 2);
+  Eigen::Quaterniond q = Eigen::AngleAxisd(yaw(random), Eigen::Vector3d::UnitZ()) * Eigen::AngleAxisd(M_PI, Eigen::Vector3d::UnitX());
+
+  geometry_msgs::msg::Pose pose;
+  pose.position.x = x(random);
+  pose.position.y = y(random);
+  pose.position.z = 1.276;
+  pose.orientation.x = q.x();
+  pose.orientation.y = q.y();
+  pose.orientation.z = q.z();
+  pose.orientation.w = q.w();
+  return pose;
+}
+
+int main(int argc, char **argv)
+{
+  rclcpp::init(argc, argv);
+
+  rclcpp::NodeOptions options;
+  options.automatically_declare_parameters_from_overrides(true);
+  auto node = rclcpp::Node::make_shared("planning_ablation_benchmark", options);
+
+  int requests;
+  node->get_parameter_or("requests", requests, 50);
+
+  rclcpp::executors::SingleThreadedExecutor executor;
+  executor.add_node(node);
+  std::thread spinner([&executor]()
+                      { executor.spin(); });
+
+  moveit::planning_interface::MoveGroupInterface dual_arm(node, "dual_arm");
+  moveit::planning_interface::MoveGroupInterface panda_1_arm(node, "panda_1");
+  moveit::planning_interface::MoveGroupInterface panda_2_arm(node, "panda_2");
+  for (auto *group : {&dual_arm, &panda_1_arm, &panda_2_arm})
+  {
+    group->setMaxVelocityScalingFactor(0.50);
+    group->setMaxAccelerationScalingFactor(0.50);
+    group->setNumPlanningAttempts(5);
+    group->setPlanningTime(1);
+  }
+
+  auto scene_monitor = std::make_shared<planning_scene_monitor::PlanningSceneMonitor>(node, "robot_description");
+  scene_monitor->startSceneMonitor();
+  scene_monitor->startStateMonitor();
+  scene_monitor->requestPlanningSceneState();
+
+  DecoupledPlanner decoupled(panda_1_arm, panda_2_arm, "dual_arm", 0.5, 0.5);
+  decoupled.setValidator([scene_monitor](const moveit_msgs::msg::RobotState &start, const moveit_msgs::msg::RobotTrajectory &trajectory)
+                         {
+    planning_scene_monitor::LockedPlanningSceneRO scene(scene_monitor);
+    return scene->isPathValid(start, trajectory, "dual_arm"); });
+
+  moveit::core::RobotStatePtr start = dual_arm.getCurrentState(10);
+  const moveit::core::JointModelGroup *jmg_1 = start->getJointModelGroup("panda_1");
+  const moveit::core::JointModelGroup *jmg_2 = start->getJointModelGroup("panda_2");
+
+  std::mt19937 random(1);
+  mode_result joint, decoupled_result;
+  size_t goals = 0;
+  for (int r = 0; r < requests; ++r)
+  {
+    // both arms reach their pose and the goal is collision free
+    moveit::core::RobotState goal(*start);
+    bool valid = false;
+    for (int attempt = 0; attempt < 100 && !valid; ++attempt)
+    {
+      valid = goal.setFromIK(jmg_1, random_pose(random, -0.9, -0.1), 0.05) &&
+              goal.setFromIK(jmg_2, random_pose(random, 0.1, 0.9), 0.05);
+      if (valid)
+      {
+        planning_scene_monitor::LockedPlanningSceneRO scene(scene_monitor);
+        valid = scene->isStateValid(goal, "dual_arm");
+      }
+    }
+    if (!valid)
+    {
+      continue;
+    }
+    goals++;
+
+    std::vector<double> goal_1, goal_2, goal_dual;
+    goal.copyJointGroupPositions(jmg_1, goal_1);
+    goal.copyJointGroupPositions(jmg_2, goal_2);
+    goal.copyJointGroupPositions("dual_arm", goal_dual);
+
+    moveit::planning_interface::MoveGroupInterface::Plan plan;
+    dual_arm.setStartState(*start);
+    dual_arm.setJointValueTarget(goal_dual);
+    auto begin = std::chrono::steady_clock::now();
+    bool success = dual_arm.plan(plan) == moveit::core::MoveItErrorCode::SUCCESS;
+    joint.planning_times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+    if (success)
+    {
+      joint.planned++;
+      joint.motion_time += motion_time(plan);
+    }
+
+    begin = std::chrono::steady_clock::now();
+    success = decoupled.plan(*start, goal_1, goal_2, plan);
+    decoupled_result.planning_times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+    if (success)
+    {
+      decoupled_result.planned++;
+      decoupled_result.motion_time += motion_time(plan);
+    }
+  }
+
+  report("dual_arm", joint, goals);
+  report("decoupled", decoupled_result, goals);
+
+  executor.cancel();
+  spinner.join();
+  rclcpp::shutdown();
+  return 0;
+}
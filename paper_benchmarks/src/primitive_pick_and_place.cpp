@@ -16,6 +16,14 @@ primitive_pick_and_place::primitive_pick_and_place(rclcpp::Node::SharedPtr node,
     robot_model = move_group_interface->getRobotModel();
     joint_model_group = robot_model->getJointModelGroup(move_group);
     joint_names = joint_model_group->getVariableNames();
+    ik_service = std::make_shared<IkService>(robot_model, joint_model_group, 0.1);
+
+    // several restarts per solve for the single arms; dual_arm has no
+    // solver of its own
+    if (joint_model_group->getSolverInstance())
+    {
+        ik_service->setParallel(std::make_shared<ParallelIk>(node, move_group));
+    }
 
     for (auto &eef : robot_model->getEndEffectors())
     {
@@ -32,6 +40,7 @@ bool primitive_pick_and_place::home()
 {
     move_group_interface->setStartStateToCurrentState();
     move_group_interface->setNamedTarget("home");
+    has_target_pose = false;
     return plan_and_execute();
 }
 
@@ -90,8 +99,16 @@ bool primitive_pick_and_place::release_object(moveit_msgs::msg::CollisionObject
 
 bool primitive_pick_and_place::set_joint_values_from_pose(geometry_msgs::msg::Pose &pose)
 {
-    current_state = move_group_interface->getCurrentState();
-    bool found_ik = current_state->setFromIK(joint_model_group, pose, 0.1);
+    // only the first solve waits for a joint state, later ones warm start
+    // from the previous solution
+    if (!ik_service->hasSeed())
+    {
+        std::vector<double> seed;
+        current_state = move_group_interface->getCurrentState();
+        current_state->copyJointGroupPositions(joint_model_group, seed);
+        ik_service->setSeed(seed);
+    }
+    bool found_ik = ik_service->solve(pose, joint_values);
 
     if (!found_ik)
     {
@@ -99,9 +116,9 @@ bool primitive_pick_and_place::set_joint_values_from_pose(geometry_msgs::msg::Po
         return false;
     }
 
-    current_state->copyJointGroupPositions(joint_model_group, joint_values);
-
     move_group_interface->setJointValueTarget(joint_names, joint_values);
+    target_pose = pose;
+    has_target_pose = true;
 
     return true;
 }
@@ -114,6 +131,22 @@ std::vector<double> primitive_pick_and_place::get_joint_values()
 bool primitive_pick_and_place::generate_plan()
 {
     move_group_interface->setStartStateToCurrentState();
+
+    // straight up or down from where the last motion ended is interpolated
+    // instead of planned
+    if (has_target_pose && has_reached_pose && vertical_move(reached_pose, target_pose))
+    {
+        plan_success = plan_straight_line(*move_group_interface, target_pose, plan);
+        if (plan_success)
+        {
+            RCLCPP_INFO(node->get_logger(), "[metric] straight line planned in %.3f s", plan.planning_time_);
+            // the line may end on another IK branch than the target's
+            ik_service->setSeed(plan.trajectory_.joint_trajectory.points.back().positions);
+            return true;
+        }
+        RCLCPP_INFO(node->get_logger(), "Straight line failed, planning");
+    }
+
     plan_success = move_group_interface->plan(plan) == moveit::core::MoveItErrorCode::SUCCESS;
     return plan_success;
 }
@@ -121,15 +154,27 @@ bool primitive_pick_and_place::generate_plan()
 bool primitive_pick_and_place::execute()
 {
     execution_success = move_group_interface->execute(plan, rclcpp::Duration::from_seconds(10)) == moveit::core::MoveItErrorCode::SUCCESS;
+    reached(execution_success);
     return execution_success;
 }
 
 bool primitive_pick_and_place::plan_and_execute()
 {
     execution_success = move_group_interface->move() == moveit::core::MoveItErrorCode::SUCCESS;
+    reached(execution_success);
     return execution_success;
 }
 
+void primitive_pick_and_place::reached(bool success)
+{
+    // after a failed motion the arm is somewhere on the way
+    has_reached_pose = success && has_target_pose;
+    if (has_reached_pose)
+    {
+        reached_pose = target_pose;
+    }
+}
+
 bool primitive_pick_and_place::is_plan_successful()
 {
     return plan_success;
@@ -141,6 +186,11 @@ bool primitive_pick_and_place::is_execution_successful()
 }
 
 
+std::shared_ptr<IkService> primitive_pick_and_place::ik_solver()
+{
+    return ik_service;
+}
+
 void primitive_pick_and_place::set_default(){
     plan_success = false;
     execution_success = false;